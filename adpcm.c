@@ -0,0 +1,389 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "adpcm.h"
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define ADPCM_X86
+#include <immintrin.h>
+#endif
+
+#define ADPCM_MAGIC 0x34414d49 // "IMA4"
+#define ADPCM_STEPS 89
+
+AdpcmDecodeFunc decodeAdpcm = decodeAdpcmScalar;
+
+static const int stepTable[ADPCM_STEPS] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97,
+    107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428,
+    4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350,
+    22385, 24623, 27086, 29794, 32767};
+
+static const int indexTable[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+// a block of silence for the lanes a call has no block for
+static const Uint8 silentBlock[ADPCM_BLOCK_BYTES];
+
+// moves the predictor and step index on by one nibble, the same way for
+// the encoder and the decoder so they never drift apart
+static void stepNibble(int nibble, int *pred, int *index)
+{
+    int step = stepTable[*index];
+    int diff = step >> 3;
+    if (nibble & 1)
+        diff += step >> 2;
+    if (nibble & 2)
+        diff += step >> 1;
+    if (nibble & 4)
+        diff += step;
+    *pred += nibble & 8 ? -diff : diff;
+    *pred = SDL_min(SDL_max(*pred, -32768), 32767);
+    *index = SDL_min(SDL_max(*index + indexTable[nibble & 7], 0), ADPCM_STEPS - 1);
+}
+
+void decodeAdpcmScalar(const Uint8 **blocks, int count, float *lanes)
+{
+    int l, i;
+    for (l = 0; l < ADPCM_LANES; ++l)
+    {
+        const Uint8 *b = l < count ? blocks[l] : silentBlock;
+        int pred = (Sint16)(b[0] | b[1] << 8);
+        int index = SDL_min(b[2], ADPCM_STEPS - 1);
+        for (i = 0; i < ADPCM_BLOCK_FRAMES; ++i)
+        {
+            stepNibble(b[4 + i / 2] >> (i & 1) * 4 & 15, &pred, &index);
+            lanes[i * ADPCM_LANES + l] = pred * (1.0f / 32768.0f);
+        }
+    }
+}
+
+// the nibbles of 8 samples of a block, the first in the low bits
+static Uint32 nibbleWord(const Uint8 *b, int word)
+{
+    const Uint8 *p = b + 4 + word * 4;
+    return p[0] | p[1] << 8 | p[2] << 16 | (Uint32)p[3] << 24;
+}
+
+#ifdef ADPCM_X86
+
+// sse2 has no gather or 32 bit min and max, so the step lookup goes
+// through memory and the clamps through 16 bit saturation, which is what
+// they clamp to anyway
+__attribute__((target("sse2")))
+void decodeAdpcmSSE2(const Uint8 **blocks, int count, float *lanes)
+{
+    const __m128i one = _mm_set1_epi32(1), two = _mm_set1_epi32(2), three = _mm_set1_epi32(3);
+    const __m128i four = _mm_set1_epi32(4), eight = _mm_set1_epi32(8), fifteen = _mm_set1_epi32(15);
+    const __m128i lastStep = _mm_set1_epi32(ADPCM_STEPS - 1), minusOne = _mm_set1_epi32(-1);
+    const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+    int h, l, w, j;
+
+    for (h = 0; h < ADPCM_LANES; h += 4)
+    {
+        const Uint8 *b[4];
+        int header[2][4];
+        __m128i pred, index;
+        for (l = 0; l < 4; ++l)
+        {
+            b[l] = h + l < count ? blocks[h + l] : silentBlock;
+            header[0][l] = (Sint16)(b[l][0] | b[l][1] << 8);
+            header[1][l] = SDL_min(b[l][2], ADPCM_STEPS - 1);
+        }
+        pred = _mm_loadu_si128((const __m128i *)header[0]);
+        index = _mm_loadu_si128((const __m128i *)header[1]);
+
+        for (w = 0; w < ADPCM_BLOCK_FRAMES / 8; ++w)
+        {
+            __m128i word = _mm_set_epi32(nibbleWord(b[3], w), nibbleWord(b[2], w), nibbleWord(b[1], w),
+                nibbleWord(b[0], w));
+            for (j = 0; j < 8; ++j)
+            {
+                int at[4];
+                __m128i nibble = _mm_and_si128(word, fifteen);
+                __m128i step, diff, sign, big, move, packed;
+                _mm_storeu_si128((__m128i *)at, index);
+                step = _mm_set_epi32(stepTable[at[3]], stepTable[at[2]], stepTable[at[1]], stepTable[at[0]]);
+
+                diff = _mm_srli_epi32(step, 3);
+                diff = _mm_add_epi32(diff, _mm_and_si128(_mm_cmpeq_epi32(_mm_and_si128(nibble, one), one),
+                    _mm_srli_epi32(step, 2)));
+                diff = _mm_add_epi32(diff, _mm_and_si128(_mm_cmpeq_epi32(_mm_and_si128(nibble, two), two),
+                    _mm_srli_epi32(step, 1)));
+                big = _mm_cmpeq_epi32(_mm_and_si128(nibble, four), four);
+                diff = _mm_add_epi32(diff, _mm_and_si128(big, step));
+                sign = _mm_cmpeq_epi32(_mm_and_si128(nibble, eight), eight);
+                diff = _mm_sub_epi32(_mm_xor_si128(diff, sign), sign);
+
+                pred = _mm_add_epi32(pred, diff);
+                packed = _mm_packs_epi32(pred, pred);
+                pred = _mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16);
+
+                // -1 for the small nibbles, 2, 4, 6 or 8 for the big ones.
+                // index stays small enough that 16 bit min and max do
+                move = _mm_add_epi32(_mm_add_epi32(_mm_and_si128(nibble, three), _mm_and_si128(nibble, three)), two);
+                move = _mm_or_si128(_mm_and_si128(big, move), _mm_andnot_si128(big, minusOne));
+                index = _mm_add_epi32(index, move);
+                index = _mm_min_epi16(_mm_max_epi16(index, _mm_setzero_si128()), lastStep);
+
+                _mm_storeu_ps(lanes + (w * 8 + j) * ADPCM_LANES + h, _mm_mul_ps(_mm_cvtepi32_ps(pred), scale));
+                word = _mm_srli_epi32(word, 4);
+            }
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+void decodeAdpcmAVX2(const Uint8 **blocks, int count, float *lanes)
+{
+    const __m256i one = _mm256_set1_epi32(1), two = _mm256_set1_epi32(2), three = _mm256_set1_epi32(3);
+    const __m256i four = _mm256_set1_epi32(4), eight = _mm256_set1_epi32(8), fifteen = _mm256_set1_epi32(15);
+    const __m256i lastStep = _mm256_set1_epi32(ADPCM_STEPS - 1), minusOne = _mm256_set1_epi32(-1);
+    const __m256i low = _mm256_set1_epi32(-32768), high = _mm256_set1_epi32(32767);
+    const __m256 scale = _mm256_set1_ps(1.0f / 32768.0f);
+    const Uint8 *b[ADPCM_LANES];
+    int header[2][ADPCM_LANES];
+    __m256i pred, index;
+    int l, w, j;
+
+    for (l = 0; l < ADPCM_LANES; ++l)
+    {
+        b[l] = l < count ? blocks[l] : silentBlock;
+        header[0][l] = (Sint16)(b[l][0] | b[l][1] << 8);
+        header[1][l] = SDL_min(b[l][2], ADPCM_STEPS - 1);
+    }
+    pred = _mm256_loadu_si256((const __m256i *)header[0]);
+    index = _mm256_loadu_si256((const __m256i *)header[1]);
+
+    for (w = 0; w < ADPCM_BLOCK_FRAMES / 8; ++w)
+    {
+        __m256i word = _mm256_set_epi32(nibbleWord(b[7], w), nibbleWord(b[6], w), nibbleWord(b[5], w),
+            nibbleWord(b[4], w), nibbleWord(b[3], w), nibbleWord(b[2], w), nibbleWord(b[1], w), nibbleWord(b[0], w));
+        for (j = 0; j < 8; ++j)
+        {
+            __m256i nibble = _mm256_and_si256(word, fifteen);
+            __m256i step = _mm256_i32gather_epi32(stepTable, index, 4);
+            __m256i diff, sign, big, move;
+
+            diff = _mm256_srli_epi32(step, 3);
+            diff = _mm256_add_epi32(diff, _mm256_and_si256(_mm256_cmpeq_epi32(_mm256_and_si256(nibble, one), one),
+                _mm256_srli_epi32(step, 2)));
+            diff = _mm256_add_epi32(diff, _mm256_and_si256(_mm256_cmpeq_epi32(_mm256_and_si256(nibble, two), two),
+                _mm256_srli_epi32(step, 1)));
+            big = _mm256_cmpeq_epi32(_mm256_and_si256(nibble, four), four);
+            diff = _mm256_add_epi32(diff, _mm256_and_si256(big, step));
+            sign = _mm256_cmpeq_epi32(_mm256_and_si256(nibble, eight), eight);
+            diff = _mm256_sub_epi32(_mm256_xor_si256(diff, sign), sign);
+            pred = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(pred, diff), low), high);
+
+            move = _mm256_add_epi32(_mm256_slli_epi32(_mm256_and_si256(nibble, three), 1), two);
+            move = _mm256_blendv_epi8(minusOne, move, big);
+            index = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(index, move), _mm256_setzero_si256()),
+                lastStep);
+
+            _mm256_storeu_ps(lanes + (w * 8 + j) * ADPCM_LANES, _mm256_mul_ps(_mm256_cvtepi32_ps(pred), scale));
+            word = _mm256_srli_epi32(word, 4);
+        }
+    }
+    _mm256_zeroupper();
+}
+
+#else
+
+void decodeAdpcmSSE2(const Uint8 **blocks, int count, float *lanes)
+{
+    decodeAdpcmScalar(blocks, count, lanes);
+}
+
+void decodeAdpcmAVX2(const Uint8 **blocks, int count, float *lanes)
+{
+    decodeAdpcmScalar(blocks, count, lanes);
+}
+
+#endif
+
+// the nibble whose step lands nearest the sample, found the usual way by
+// taking off the step and its halves
+static int encodeNibble(int sample, int pred, int index)
+{
+    int step = stepTable[index];
+    int diff = sample - pred;
+    int nibble = 0;
+    if (diff < 0)
+    {
+        nibble = 8;
+        diff = -diff;
+    }
+    if (diff >= step)
+    {
+        nibble |= 4;
+        diff -= step;
+    }
+    step >>= 1;
+    if (diff >= step)
+    {
+        nibble |= 2;
+        diff -= step;
+    }
+    step >>= 1;
+    if (diff >= step)
+        nibble |= 1;
+    return nibble;
+}
+
+int encodeAdpcm(AdpcmSample *a, const Sample *s, int freq)
+{
+    int c, block, i;
+
+    if (s->channels < 1 || s->channels > ADPCM_MAX_CHANNELS)
+    {
+        printf("Can't compress a sample with %d channels\n", s->channels);
+        return 0;
+    }
+
+    a->frames = s->frames;
+    a->channels = s->channels;
+    a->freq = freq;
+    a->blocks = (int)((s->frames + ADPCM_BLOCK_FRAMES - 1) / ADPCM_BLOCK_FRAMES);
+    a->data = calloc(a->blocks * a->channels, ADPCM_BLOCK_BYTES);
+    if (a->data == NULL)
+    {
+        printf("Out of memory compressing a sample of %lu frames\n", s->frames);
+        a->frames = 0;
+        a->blocks = 0;
+        return 0;
+    }
+
+    for (c = 0; c < a->channels; ++c)
+    {
+        // the state runs on across blocks, the headers just record it
+        int pred = 0, index = 0;
+        for (block = 0; block < a->blocks; ++block)
+        {
+            Uint8 *b = (Uint8 *)adpcmBlock(a, block, c);
+            b[0] = pred & 0xff;
+            b[1] = (pred >> 8) & 0xff;
+            b[2] = (Uint8)index;
+            for (i = 0; i < ADPCM_BLOCK_FRAMES; ++i)
+            {
+                unsigned long frame = (unsigned long)block * ADPCM_BLOCK_FRAMES + i;
+                float x = frame < s->frames ? s->data[frame * s->channels + c] : 0;
+                int sample = (int)SDL_min(SDL_max(x * 32768.0f, -32768.0f), 32767.0f);
+                int nibble = encodeNibble(sample, pred, index);
+                b[4 + i / 2] |= nibble << (i & 1) * 4;
+                stepNibble(nibble, &pred, &index);
+            }
+        }
+    }
+    return 1;
+}
+
+void freeAdpcm(AdpcmSample *a)
+{
+    free(a->data);
+    a->data = NULL;
+    a->frames = 0;
+    a->blocks = 0;
+}
+
+const Uint8 *adpcmBlock(const AdpcmSample *a, int block, int channel)
+{
+    return a->data + ((size_t)block * a->channels + channel) * ADPCM_BLOCK_BYTES;
+}
+
+static size_t adpcmBytes(const AdpcmSample *a)
+{
+    return (size_t)a->blocks * a->channels * ADPCM_BLOCK_BYTES;
+}
+
+int saveAdpcm(const AdpcmSample *a, const char *path)
+{
+    SDL_RWops *file = SDL_RWFromFile(path, "wb");
+    int ok;
+    if (file == NULL)
+    {
+        printf("Could not open %s: %s\n", path, SDL_GetError());
+        return 0;
+    }
+
+    ok = SDL_WriteLE32(file, ADPCM_MAGIC) && SDL_WriteLE32(file, a->freq) && SDL_WriteLE32(file, a->channels) &&
+        SDL_WriteLE32(file, (Uint32)a->frames) && SDL_RWwrite(file, a->data, adpcmBytes(a), 1) == 1;
+    if (!ok)
+        printf("Could not write %s: %s\n", path, SDL_GetError());
+    SDL_RWclose(file);
+    return ok;
+}
+
+int loadAdpcm(AdpcmSample *a, const char *path)
+{
+    SDL_RWops *file = SDL_RWFromFile(path, "rb");
+    if (file == NULL)
+    {
+        printf("Could not open %s: %s\n", path, SDL_GetError());
+        return 0;
+    }
+
+    if (SDL_ReadLE32(file) != ADPCM_MAGIC)
+    {
+        printf("%s is not compressed audio\n", path);
+        SDL_RWclose(file);
+        return 0;
+    }
+    a->freq = SDL_ReadLE32(file);
+    a->channels = SDL_ReadLE32(file);
+    a->frames = SDL_ReadLE32(file);
+    if (a->freq <= 0 || a->channels < 1 || a->channels > ADPCM_MAX_CHANNELS)
+    {
+        printf("%s has a bad header\n", path);
+        SDL_RWclose(file);
+        return 0;
+    }
+
+    // nothing to play, and no blocks to read
+    if (a->frames == 0)
+    {
+        printf("%s has no frames\n", path);
+        SDL_RWclose(file);
+        return 0;
+    }
+
+    a->blocks = (int)((a->frames + ADPCM_BLOCK_FRAMES - 1) / ADPCM_BLOCK_FRAMES);
+    a->data = malloc(adpcmBytes(a));
+    if (a->data == NULL)
+    {
+        printf("Out of memory loading %s\n", path);
+        SDL_RWclose(file);
+        a->frames = 0;
+        a->blocks = 0;
+        return 0;
+    }
+    if (SDL_RWread(file, a->data, adpcmBytes(a), 1) != 1)
+    {
+        printf("%s is cut short\n", path);
+        SDL_RWclose(file);
+        freeAdpcm(a);
+        return 0;
+    }
+    SDL_RWclose(file);
+    return 1;
+}
+
+void initAdpcm()
+{
+    decodeAdpcm = decodeAdpcmScalar;
+#ifdef ADPCM_X86
+    if (SDL_HasAVX2())
+        decodeAdpcm = decodeAdpcmAVX2;
+    else if (SDL_HasSSE2())
+        decodeAdpcm = decodeAdpcmSSE2;
+#endif
+}
+
+const char *adpcmKernelName()
+{
+    if (decodeAdpcm == decodeAdpcmAVX2)
+        return "avx2";
+    if (decodeAdpcm == decodeAdpcmSSE2)
+        return "sse2";
+    return "scalar";
+}
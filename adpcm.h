@@ -0,0 +1,61 @@
+#ifndef ADPCM_H
+#define ADPCM_H
+
+#include <SDL.h>
+
+#include "sample.h"
+
+// ima adpcm in blocks that decode on their own. each channel of a block
+// starts with its predictor and step index, so a voice can start anywhere
+// and blocks of different voices can be decoded side by side
+#define ADPCM_BLOCK_FRAMES 256
+#define ADPCM_BLOCK_BYTES (4 + ADPCM_BLOCK_FRAMES / 2)
+#define ADPCM_MAX_CHANNELS 2
+
+// channel blocks a decoder call works through at once
+#define ADPCM_LANES 8
+
+// a compressed sample, about 4 bits a sample. the blocks are one after
+// the other with the channels of each together, and the last is padded
+typedef struct
+{
+    Uint8 *data;
+    unsigned long frames;
+    int channels;
+    int blocks;
+    int freq;
+} AdpcmSample;
+
+// decodes all ADPCM_BLOCK_FRAMES samples of count channel blocks into
+// lanes, interleaved so lanes[i * ADPCM_LANES + l] is sample i of block l.
+// ima adpcm can't be decoded faster than a sample at a time, so the
+// vector kernels decode a block in each lane
+typedef void (*AdpcmDecodeFunc)(const Uint8 **blocks, int count, float *lanes);
+
+// best kernel for this cpu, set by initAdpcm()
+extern AdpcmDecodeFunc decodeAdpcm;
+
+void decodeAdpcmScalar(const Uint8 **blocks, int count, float *lanes);
+void decodeAdpcmSSE2(const Uint8 **blocks, int count, float *lanes);
+void decodeAdpcmAVX2(const Uint8 **blocks, int count, float *lanes);
+
+// compresses a mono or stereo sample at freq. returns 0 for more channels,
+// or if there isn't the memory for it
+int encodeAdpcm(AdpcmSample *a, const Sample *s, int freq);
+
+void freeAdpcm(AdpcmSample *a);
+
+// the start of a channel of a block
+const Uint8 *adpcmBlock(const AdpcmSample *a, int block, int channel);
+
+// a file of the header and the blocks as they are in memory. return 0 if
+// the file can't be written or read. a file of no frames isn't loaded
+int saveAdpcm(const AdpcmSample *a, const char *path);
+int loadAdpcm(AdpcmSample *a, const char *path);
+
+// picks the kernel for this cpu
+void initAdpcm();
+
+const char *adpcmKernelName();
+
+#endif
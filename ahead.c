@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ahead.h"
+
+// renders n frames into the ring starting at frame first
+static void renderRing(RenderAhead *a, int first, int n)
+{
+    int ringFrame = first & (a->ringFrames - 1);
+    // a block never wraps, ringFrames is a multiple of the block size
+    mixerRender(a->mixer, a->ring + ringFrame * a->channels, n);
+}
+
+// the mixer thread's side of the clock, keeping the last good one if the
+// audio thread is in the middle of writing
+static void readClock(RenderAhead *a)
+{
+    int sequence = SDL_AtomicGet(&a->clockSequence);
+    Uint64 time;
+    int frame;
+    if (sequence & 1)
+        return;
+    time = (Uint64)(Uint32)SDL_AtomicGet(&a->clockTime[1]) << 32 | (Uint32)SDL_AtomicGet(&a->clockTime[0]);
+    frame = SDL_AtomicGet(&a->clockFrame);
+    if (SDL_AtomicGet(&a->clockSequence) == sequence && time != 0)
+        mixerSetClock(a->mixer, time, (Uint32)frame, a->lookahead + AHEAD_BLOCK_FRAMES + a->latency);
+}
+
+static int mixerThread(void *data)
+{
+    RenderAhead *a = data;
+    // sleep for about half a block when the lookahead is full
+    int delay = SDL_max(1, AHEAD_BLOCK_FRAMES * 500 / a->mixer->freq);
+
+    SDL_SetThreadPriority(SDL_THREAD_PRIORITY_HIGH);
+    while (!SDL_AtomicGet(&a->quit))
+    {
+        int written = SDL_AtomicGet(&a->written);
+        if (written - SDL_AtomicGet(&a->read) >= a->lookahead)
+        {
+            SDL_Delay(delay);
+            continue;
+        }
+
+        readClock(a);
+        renderRing(a, written, AHEAD_BLOCK_FRAMES);
+        // the frames have to land before the count that covers them
+        SDL_MemoryBarrierRelease();
+        SDL_AtomicSet(&a->written, written + AHEAD_BLOCK_FRAMES);
+    }
+    return 0;
+}
+
+RenderAhead *startRenderAhead(Mixer *m, int lookahead, int latency)
+{
+    RenderAhead *a = calloc(1, sizeof(RenderAhead));
+    int written;
+
+    a->mixer = m;
+    a->latency = latency;
+    a->channels = m->channels;
+    a->lookahead = (SDL_max(lookahead, 1) + AHEAD_BLOCK_FRAMES - 1) / AHEAD_BLOCK_FRAMES * AHEAD_BLOCK_FRAMES;
+    // room for the lookahead plus the block being rendered past it
+    a->ringFrames = AHEAD_BLOCK_FRAMES;
+    while (a->ringFrames < a->lookahead + AHEAD_BLOCK_FRAMES)
+        a->ringFrames *= 2;
+    a->ring = calloc(a->ringFrames * a->channels, sizeof(Sint16));
+    SDL_AtomicSet(&a->minFill, a->ringFrames);
+
+    for (written = 0; written < a->lookahead; written += AHEAD_BLOCK_FRAMES)
+        renderRing(a, written, AHEAD_BLOCK_FRAMES);
+    SDL_AtomicSet(&a->written, written);
+
+    a->thread = SDL_CreateThread(mixerThread, "mixer", a);
+    return a;
+}
+
+void stopRenderAhead(RenderAhead *a)
+{
+    SDL_AtomicSet(&a->quit, 1);
+    SDL_WaitThread(a->thread, NULL);
+    free(a->ring);
+    free(a);
+}
+
+void readRenderAhead(RenderAhead *a, Sint16 *stream, int frames, int queued)
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    int read = SDL_AtomicGet(&a->read);
+    int available = SDL_AtomicGet(&a->written) - read;
+    int n = SDL_min(frames, available);
+    int done = 0;
+    // read the count before the frames it covers
+    SDL_MemoryBarrierAcquire();
+
+    SDL_AtomicAdd(&a->clockSequence, 1);
+    SDL_AtomicSet(&a->clockTime[0], (int)(Uint32)now);
+    SDL_AtomicSet(&a->clockTime[1], (int)(Uint32)(now >> 32));
+    // the device is playing the frame queued before these, not these
+    SDL_AtomicSet(&a->clockFrame, read - queued);
+    SDL_AtomicAdd(&a->clockSequence, 1);
+
+    SDL_AtomicAdd(&a->callbacks, 1);
+    SDL_AtomicAdd(&a->fill[SDL_min(available * 100 / a->lookahead / AHEAD_FILL_PERCENT, AHEAD_FILL_BUCKETS - 1)], 1);
+    if (available < SDL_AtomicGet(&a->minFill))
+        SDL_AtomicSet(&a->minFill, available);
+
+    while (done < n)
+    {
+        int ringFrame = (read + done) & (a->ringFrames - 1);
+        int count = SDL_min(n - done, a->ringFrames - ringFrame);
+        SDL_memcpy(stream + done * a->channels, a->ring + ringFrame * a->channels, count * a->channels * sizeof(Sint16));
+        done += count;
+    }
+
+    if (n < frames)
+    {
+        SDL_memset(stream + n * a->channels, 0, (frames - n) * a->channels * sizeof(Sint16));
+        SDL_AtomicAdd(&a->underruns, 1);
+    }
+    // the frames are copied, so the mixer thread can have them back
+    SDL_AtomicSet(&a->read, read + n);
+}
+
+void printRenderAhead(RenderAhead *a)
+{
+    int callbacks = SDL_AtomicGet(&a->callbacks);
+    int i;
+
+    printf("render ahead: lookahead %d frames (%.1f ms), %d callbacks, %d underruns, min fill %d frames\n",
+        a->lookahead, a->lookahead * 1000.0 / a->mixer->freq, callbacks,
+        SDL_AtomicGet(&a->underruns), callbacks ? SDL_AtomicGet(&a->minFill) : 0);
+    for (i = 0; i < AHEAD_FILL_BUCKETS; ++i)
+    {
+        int count = SDL_AtomicGet(&a->fill[i]);
+        if (count == 0)
+            continue;
+        if (i == AHEAD_FILL_BUCKETS - 1)
+            printf("  full   %d\n", count);
+        else
+            printf("  <%3d%%  %d\n", (i + 1) * AHEAD_FILL_PERCENT, count);
+    }
+}
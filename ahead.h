@@ -0,0 +1,73 @@
+#ifndef AHEAD_H
+#define AHEAD_H
+
+#include <SDL.h>
+
+#include "mixer.h"
+
+// frames the mixer thread renders at a time
+#define AHEAD_BLOCK_FRAMES 256
+
+// the ring fill the callback sees goes in buckets of this many percent of
+// the lookahead, the last one takes anything at or over the lookahead
+#define AHEAD_FILL_PERCENT 10
+#define AHEAD_FILL_BUCKETS 11
+
+// a thread that runs the mixer ahead of the audio device into a ring of
+// 16 bit frames, so the callback only copies and a slow buffer is covered
+// by the frames already rendered. everything the game does reaches the
+// speakers up to lookahead frames later.
+// the mixer thread is the only writer of written and the audio thread of
+// everything else, the same as a SampleStream
+typedef struct
+{
+    Mixer *mixer;
+    Sint16 *ring;
+    int ringFrames; // power of two
+    int lookahead; // frames the mixer thread keeps ready
+    // most frames the output holds before the ones it takes from the
+    // ring, the output's latency
+    int latency;
+    int channels;
+
+    // frame counts since the start, they only ever go up
+    SDL_atomic_t written; // by the mixer thread
+    SDL_atomic_t read; // by the audio thread
+
+    // when the audio thread last took frames and the frame the device was
+    // playing then, the first of them less what it had queued, for the
+    // mixer's clock. a sequence lock like the mixer's voice params
+    SDL_atomic_t clockSequence;
+    SDL_atomic_t clockTime[2]; // low and high halves of the performance counter
+    SDL_atomic_t clockFrame;
+
+    SDL_atomic_t callbacks;
+    SDL_atomic_t underruns; // callbacks that found fewer frames than they wanted
+    SDL_atomic_t minFill; // fewest frames a callback found ready
+    SDL_atomic_t fill[AHEAD_FILL_BUCKETS];
+
+    SDL_atomic_t quit;
+    SDL_Thread *thread;
+} RenderAhead;
+
+// starts a thread rendering m into a ring and fills the lookahead first.
+// lookahead is rounded up to whole blocks and has to be at least the
+// device buffer, or every callback comes up short. latency is the
+// output's, so timed commands can allow for what it has queued.
+// from then on only the thread may call mixerRender on m
+RenderAhead *startRenderAhead(Mixer *m, int lookahead, int latency);
+
+// stops the thread and frees the ring. close the audio device first
+void stopRenderAhead(RenderAhead *a);
+
+// audio thread. copies frames frames out of the ring into stream, filling
+// with silence if the mixer thread has fallen behind. queued is how many
+// frames the device has to play before them. the mixer thread keeps the
+// mixer's clock from when this was called, scheduling timed commands a
+// lookahead, a block and the output's latency after their time
+void readRenderAhead(RenderAhead *a, Sint16 *stream, int frames, int queued);
+
+// prints the underruns and how full the ring has been
+void printRenderAhead(RenderAhead *a);
+
+#endif
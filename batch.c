@@ -0,0 +1,88 @@
+#include <stdio.h>
+
+#include "batch.h"
+
+void initDrawBatch(DrawBatch *b)
+{
+    SDL_memset(b, 0, sizeof(DrawBatch));
+    // the commands' base instance needs 4.2 too
+    b->indirect = (GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect) && (GLEW_VERSION_4_2 || GLEW_ARB_base_instance);
+    if (!b->indirect)
+        return;
+    b->capacity = 64;
+    glGenBuffers(1, &b->buffer);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, b->buffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, b->capacity * sizeof(DrawCommand), NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void freeDrawBatch(DrawBatch *b)
+{
+    if (b->buffer)
+        glDeleteBuffers(1, &b->buffer);
+    b->buffer = 0;
+}
+
+void beginDrawBatch(DrawBatch *b)
+{
+    b->count = 0;
+}
+
+int batchMesh(DrawBatch *b, const Mesh *m, int first, int count)
+{
+    if (b->count == BATCH_MAX_DRAWS)
+        return 0;
+    if (count <= 0)
+        return 1;
+    DrawCommand *c = &b->commands[b->count++];
+    c->count = m->indexCount;
+    c->instanceCount = count;
+    c->firstIndex = m->firstIndex;
+    c->baseVertex = m->firstVertex;
+    c->baseInstance = first;
+    return 1;
+}
+
+void submitDrawBatch(DrawBatch *b, InstanceBuffer *instances)
+{
+    int i;
+
+    b->draws = b->count;
+    b->instances = 0;
+    for (i = 0; i < b->count; ++i)
+        b->instances += b->commands[i].instanceCount;
+    b->calls = 0;
+    if (b->count == 0)
+        return;
+
+    if (!b->indirect)
+    {
+        for (i = 0; i < b->count; ++i)
+        {
+            DrawCommand *c = &b->commands[i];
+            drawInstances(instances, GL_LINES, c->count, c->firstIndex, c->baseVertex, c->baseInstance, c->instanceCount);
+        }
+        b->calls = b->count;
+        return;
+    }
+
+    // the frame's matrices are somewhere in the instance ring
+    for (i = 0; i < b->count; ++i)
+        b->commands[i].baseInstance += instances->base;
+
+    // fresh storage every frame
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, b->buffer);
+    if (b->count > b->capacity)
+        b->capacity = SDL_max(b->count, b->capacity * 2);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, b->capacity * sizeof(DrawCommand), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, b->count * sizeof(DrawCommand), b->commands);
+    glMultiDrawElementsIndirect(GL_LINES, GL_UNSIGNED_INT, NULL, b->count, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    b->calls = 1;
+}
+
+void printDrawBatch(DrawBatch *b)
+{
+    printf("draws: %d instances in %d draws, %d calls, %s\n", b->instances, b->draws, b->calls,
+        b->indirect ? "multi draw indirect" : "a call a draw");
+}
@@ -0,0 +1,60 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <SDL.h>
+#include <gl\glew.h>
+
+#include "instance.h"
+#include "mesh.h"
+
+#define BATCH_MAX_DRAWS 16384
+
+// one draw as glMultiDrawElementsIndirect reads it. the instances take
+// their matrices from baseInstance on
+typedef struct
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+} DrawCommand;
+
+// the draws of everything with one program, gathered over a frame and
+// submitted together. with multi draw indirect that is one call whatever
+// is in it. without, every command is its own instanced draw. the multi
+// draw calls of gl 3.3 can't give each draw its own transforms, they have
+// no instances or draw id, so they don't help here
+typedef struct
+{
+    GLuint buffer; // the commands, for GL_DRAW_INDIRECT_BUFFER
+    int capacity; // commands buffer has room for
+    int indirect; // glMultiDrawElementsIndirect can be used
+    int count;
+    DrawCommand commands[BATCH_MAX_DRAWS];
+
+    // what the last submit drew
+    int draws;
+    int calls;
+    int instances;
+} DrawBatch;
+
+void initDrawBatch(DrawBatch *b);
+
+void freeDrawBatch(DrawBatch *b);
+
+// empties the batch for the next frame
+void beginDrawBatch(DrawBatch *b);
+
+// adds count instances of a mesh, with the matrices from instance first
+// on. returns 0 if the batch is full
+int batchMesh(DrawBatch *b, const Mesh *m, int first, int count);
+
+// draws everything added since beginDrawBatch with the bound program and
+// the vao the mesh registry and instances are bound to
+void submitDrawBatch(DrawBatch *b, InstanceBuffer *instances);
+
+// what the last submit drew and how many calls it took
+void printDrawBatch(DrawBatch *b);
+
+#endif
@@ -0,0 +1,663 @@
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define MATH_3D_IMPLEMENTATION
+#include "math_3d.h"
+// cull.h includes it too, only the first include can have the code
+#undef MATH_3D_IMPLEMENTATION
+#include "adpcm.h"
+#include "cull.h"
+#include "filter.h"
+#include "mix.h"
+#include "mixer.h"
+#include "resample.h"
+#include "reverb.h"
+#include "stream.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// microbenchmark for the audio mixing code.
+// run from the bin directory: bench [seconds per test] [kernels|resample|mixer|spatial|virtual|reverb|filter|adpcm|cull|stream]
+// with no suite it runs them all. the mixer, spatial, virtual, reverb, filter, adpcm, cull and stream suites print csv
+
+#define BENCH_SOURCE_FRAMES 8960 // about the length of truck_idle.wav
+#define BENCH_CHANNELS 2
+#define BENCH_SOURCE_SAMPLES (BENCH_SOURCE_FRAMES * BENCH_CHANNELS)
+
+Sint16 benchSource[BENCH_SOURCE_SAMPLES];
+float benchSourceF32[BENCH_SOURCE_SAMPLES];
+
+// what the callback did before the block mixer, kept to compare against
+void mixReference(Sint16 *dst, const Sint16 *src, int count, int volume)
+{
+    int i;
+    for (i = 0; i < count; ++i)
+        SDL_MixAudioFormat((Uint8*)(dst + i), (const Uint8*)(src + i), AUDIO_S16SYS, 2, volume);
+}
+
+// each voice reads from its own place in the source
+int voiceOffset(int voice, int i)
+{
+    return (voice * 997 + i) % (BENCH_SOURCE_SAMPLES - MIX_BLOCK);
+}
+
+// the mixer before the float bus: every voice scaled and saturated
+// straight into the 16 bit stream
+void pipelineS16(int kernel, Sint16 *stream, int count, int voices)
+{
+    MixS16Func kernels[] = { mixReference, mixS16Scalar, mixS16SSE2, mixS16AVX2 };
+    int i, v;
+    SDL_memset(stream, 0, count * sizeof(Sint16));
+    for (v = 0; v < voices; ++v)
+        for (i = 0; i < count; i += MIX_BLOCK)
+            kernels[kernel](stream + i, benchSource + voiceOffset(v, i), SDL_min(MIX_BLOCK, count - i), SDL_MIX_MAXVOLUME / 4);
+}
+
+// every voice added into a block of the float bus, which is converted
+// and dithered once
+void pipelineF32(int kernel, Sint16 *stream, int count, int voices)
+{
+    MixF32Func mixes[] = { mixF32Scalar, mixF32Scalar, mixF32SSE2, mixF32AVX2 };
+    ConvertF32Func converts[] = { convertF32Scalar, convertF32Scalar, convertF32SSE2, convertF32AVX2 };
+    static Uint32 dither[MIX_DITHER_LANES];
+    float bus[MIX_BLOCK];
+    int i, v;
+
+    if (dither[0] == 0)
+        initDither(dither, 1);
+    for (i = 0; i < count; i += MIX_BLOCK)
+    {
+        int n = SDL_min(MIX_BLOCK, count - i);
+        SDL_memset(bus, 0, n * sizeof(float));
+        for (v = 0; v < voices; ++v)
+            mixes[kernel](bus, benchSourceF32 + voiceOffset(v, i), n, 0.25f);
+        converts[kernel](stream + i, bus, n, dither);
+    }
+}
+
+typedef void (*Pipeline)(int kernel, Sint16 *stream, int count, int voices);
+
+// returns output samples per second
+double benchPipeline(Pipeline pipeline, int kernel, int count, int voices, double seconds)
+{
+    Sint16 *stream = malloc(count * sizeof(Sint16));
+    Uint64 freq = SDL_GetPerformanceFrequency();
+    Uint64 start = SDL_GetPerformanceCounter();
+    Uint64 elapsed = 0;
+    unsigned long samples = 0;
+
+    while (elapsed < seconds * freq)
+    {
+        pipeline(kernel, stream, count, voices);
+        samples += count;
+        elapsed = SDL_GetPerformanceCounter() - start;
+    }
+
+    free(stream);
+    return samples * (double)freq / elapsed;
+}
+
+// returns output frames per second
+double benchResample(int quality, double rate, int frames, double seconds)
+{
+    float *stream = malloc(frames * BENCH_CHANNELS * sizeof(float));
+    Resampler r;
+    Uint64 freq = SDL_GetPerformanceFrequency();
+    Uint64 start = SDL_GetPerformanceCounter();
+    Uint64 elapsed = 0;
+    unsigned long rendered = 0;
+
+    initResampler(&r, benchSourceF32, BENCH_SOURCE_FRAMES, BENCH_CHANNELS, 1);
+    while (elapsed < seconds * freq)
+    {
+        resample(stream, frames, &r, rate, rate, quality);
+        rendered += frames;
+        elapsed = SDL_GetPerformanceCounter() - start;
+    }
+
+    free(stream);
+    return rendered * (double)freq / elapsed;
+}
+
+// returns ns per output frame of mixerRender with voices voices of the
+// source looping at 1 + pitch, the same rate the engine plays at, and at
+// most real of them mixed.
+// spatial voices drive around the listener and get new emitter positions
+// every buffer, like tanks in a battle. filtered voices have an engine
+// low-pass whose cutoff moves every buffer and an occlusion low-pass.
+// compressed voices play that instead of the source.
+// only the renders are timed
+double benchMixer(int frames, int voices, float pitch, int quality, int spatial, int filtered, const AdpcmSample *compressed, int real, double seconds, double *snapshotNs, int *mixed)
+{
+    static Mixer m;
+    static int handles[MIXER_MAX_VOICES];
+    float t = 0;
+    Sint16 *stream = malloc(frames * BENCH_CHANNELS * sizeof(Sint16));
+    Sample sample = { benchSourceF32, BENCH_SOURCE_FRAMES, BENCH_CHANNELS };
+    Uint64 freq = SDL_GetPerformanceFrequency();
+    Uint64 start, elapsed = 0, rendering = 0;
+    unsigned long rendered = 0;
+    int i;
+
+    initMixer(&m, 48000, BENCH_CHANNELS);
+    mixerSetQuality(&m, quality);
+    mixerSetRealVoices(&m, real);
+    for (i = 0; i < voices; ++i)
+    {
+        if (compressed)
+            handles[i] = mixerPlayAdpcm(&m, compressed, 1.0f / voices, 1.0f + pitch, 1);
+        else
+            handles[i] = mixerPlay(&m, &sample, 1.0f / voices, 1.0f + pitch, 1);
+        // keep the command queue from filling up
+        if (i % 64 == 63)
+            mixerRender(&m, stream, frames);
+    }
+    mixerRender(&m, stream, frames);
+    m.snapshotTicks = 0;
+    m.snapshotVoices = 0;
+
+    start = SDL_GetPerformanceCounter();
+    while (elapsed < seconds * freq)
+    {
+        Uint64 renderStart;
+        for (i = 0; spatial && i < voices; ++i)
+        {
+            float angle = t + i;
+            float radius = 2.0f + i % 50;
+            mixerSetEmitter(&m, handles[i], vec3(cosf(angle) * radius, sinf(angle) * radius, 0),
+                vec3(-sinf(angle) * radius, cosf(angle) * radius, 0));
+        }
+        for (i = 0; filtered && i < voices; ++i)
+        {
+            BiquadSettings engine = { FILTER_LOW_PASS, 1000 * powf(2, 2 + 2 * sinf(t + i)), 0.7071f, 0 };
+            mixerSetFilter(&m, handles[i], 0, &engine);
+            mixerSetOcclusion(&m, handles[i], 0.5f);
+        }
+        t += (float)frames / 48000;
+
+        renderStart = SDL_GetPerformanceCounter();
+        mixerRender(&m, stream, frames);
+        rendering += SDL_GetPerformanceCounter() - renderStart;
+        rendered += frames;
+        elapsed = SDL_GetPerformanceCounter() - start;
+    }
+
+    if (snapshotNs)
+        *snapshotNs = m.snapshotTicks * 1e9 / freq / SDL_max(m.snapshotVoices, 1);
+    if (mixed)
+        *mixed = SDL_AtomicGet(&m.mixedVoices);
+    free(stream);
+    return rendering * 1e9 / freq / rendered;
+}
+
+// returns ns per output frame of a stereo send bus going through a reverb
+// with an impulse seconds long, a mix block at a time like the mixer does
+double benchReverb(ComplexMacFunc kernel, float impulseSeconds, int blockFrames, double seconds, int *partitions)
+{
+    float send[MIX_BLOCK * BENCH_CHANNELS];
+    float bus[MIX_BLOCK * BENCH_CHANNELS];
+    Sample impulse;
+    Reverb *r;
+    ComplexMacFunc best = complexMac;
+    Uint64 freq = SDL_GetPerformanceFrequency();
+    Uint64 start, elapsed = 0;
+    unsigned long rendered = 0;
+    int offset = 0;
+
+    makeImpulse(&impulse, 48000, impulseSeconds, impulseSeconds * 0.8f, 1);
+    r = createReverb(&impulse, blockFrames, 0.3f);
+    free(impulse.data);
+    if (r == NULL)
+    {
+        *partitions = 0;
+        return 0;
+    }
+    *partitions = r->partitions;
+    complexMac = kernel;
+
+    start = SDL_GetPerformanceCounter();
+    while (elapsed < seconds * freq)
+    {
+        SDL_memcpy(send, benchSourceF32 + offset, sizeof(send));
+        SDL_memset(bus, 0, sizeof(bus));
+        reverbProcess(r, send, bus, MIX_BLOCK, BENCH_CHANNELS);
+        offset = (offset + MIX_BLOCK * BENCH_CHANNELS) % (BENCH_SOURCE_SAMPLES - MIX_BLOCK * BENCH_CHANNELS);
+        rendered += MIX_BLOCK;
+        elapsed = SDL_GetPerformanceCounter() - start;
+    }
+
+    complexMac = best;
+    freeReverb(r);
+    return elapsed * 1e9 / freq / rendered;
+}
+
+// returns ns per sample of decoding ADPCM_LANES blocks at a time
+double benchDecode(AdpcmDecodeFunc kernel, const AdpcmSample *a, double seconds)
+{
+    float lanes[ADPCM_BLOCK_FRAMES * ADPCM_LANES];
+    const Uint8 *blocks[ADPCM_LANES];
+    int total = a->blocks * a->channels;
+    Uint64 freq = SDL_GetPerformanceFrequency();
+    Uint64 start = SDL_GetPerformanceCounter();
+    Uint64 elapsed = 0;
+    unsigned long decoded = 0;
+    int next = 0, l;
+
+    while (elapsed < seconds * freq)
+    {
+        for (l = 0; l < ADPCM_LANES; ++l)
+        {
+            blocks[l] = a->data + (size_t)next * ADPCM_BLOCK_BYTES;
+            next = (next + 1) % total;
+        }
+        kernel(blocks, ADPCM_LANES, lanes);
+        decoded += ADPCM_BLOCK_FRAMES * ADPCM_LANES;
+        elapsed = SDL_GetPerformanceCounter() - start;
+    }
+    return elapsed * 1e9 / freq / decoded;
+}
+
+// plays path streamed through a window of windowFrames on a loop for
+// seconds, rendering frames at a time at speed times real time, or as fast
+// as it can at speed 0. returns how many times the voice found the ring
+// too empty, or -1 if path can't be streamed
+int benchStream(const char *path, int windowFrames, int frames, double speed, double seconds, int *buffers, int *ringFrames)
+{
+    static Mixer m;
+    Sint16 *out = malloc(frames * BENCH_CHANNELS * sizeof(Sint16));
+    SampleStream *s = openStream(path, windowFrames, 1);
+    Uint64 freq = SDL_GetPerformanceFrequency();
+    Uint64 start, elapsed = 0;
+    unsigned long rendered = 0;
+    int underruns;
+
+    *buffers = 0;
+    if (s == NULL)
+    {
+        free(out);
+        return -1;
+    }
+    *ringFrames = s->ringFrames;
+    initMixer(&m, 48000, BENCH_CHANNELS);
+    mixerPlayStream(&m, s, 1.0f, (float)s->freq / 48000);
+
+    start = SDL_GetPerformanceCounter();
+    while (elapsed < seconds * freq)
+    {
+        mixerRender(&m, out, frames);
+        rendered += frames;
+        ++*buffers;
+        // wait for when the device would want the next buffer
+        if (speed > 0)
+        {
+            Uint64 due = start + (Uint64)(rendered * freq / (48000 * speed));
+            Uint64 now = SDL_GetPerformanceCounter();
+            if (due > now)
+                SDL_Delay((Uint32)((due - now) * 1000 / freq));
+        }
+        elapsed = SDL_GetPerformanceCounter() - start;
+    }
+
+    // nothing renders the voice after this, so the stream can go
+    underruns = SDL_AtomicGet(&s->underruns);
+    closeStream(s);
+    free(out);
+    return underruns;
+}
+
+// ns per sphere to cull a whole set with kernel
+double benchCull(CullFunc kernel, const Frustum *f, CullSet *s, double seconds, int *visible)
+{
+    Uint64 freq = SDL_GetPerformanceFrequency();
+    Uint64 start = SDL_GetPerformanceCounter();
+    Uint64 elapsed = 0;
+    unsigned long tested = 0;
+
+    while (elapsed < seconds * freq)
+    {
+        *visible = kernel(f, s->x, s->y, s->z, s->radius, s->count, s->visible);
+        tested += s->count;
+        elapsed = SDL_GetPerformanceCounter() - start;
+    }
+    return elapsed * 1e9 / freq / tested;
+}
+
+// signal to noise of a after decoding, against the frames it was made from
+double adpcmSnr(const AdpcmSample *a, const float *original)
+{
+    float lanes[ADPCM_BLOCK_FRAMES * ADPCM_LANES];
+    double signal = 0, noise = 0;
+    int block, c, i;
+
+    for (block = 0; block < a->blocks; ++block)
+    {
+        const Uint8 *blocks[ADPCM_MAX_CHANNELS];
+        for (c = 0; c < a->channels; ++c)
+            blocks[c] = adpcmBlock(a, block, c);
+        decodeAdpcmScalar(blocks, a->channels, lanes);
+        for (i = 0; i < ADPCM_BLOCK_FRAMES && (unsigned long)block * ADPCM_BLOCK_FRAMES + i < a->frames; ++i)
+            for (c = 0; c < a->channels; ++c)
+            {
+                double x = original[((size_t)block * ADPCM_BLOCK_FRAMES + i) * a->channels + c];
+                double d = lanes[i * ADPCM_LANES + c] - x;
+                signal += x * x;
+                noise += d * d;
+            }
+    }
+    return 10 * log10(signal / SDL_max(noise, 1e-30));
+}
+
+// the same for 16 bit pcm, which is what the wav files hold
+double s16Snr(const float *original, int samples)
+{
+    double signal = 0, noise = 0;
+    int i;
+    for (i = 0; i < samples; ++i)
+    {
+        double x = original[i];
+        double d = (int)SDL_min(SDL_max(x * 32768.0f, -32768.0f), 32767.0f) / 32768.0 - x;
+        signal += x * x;
+        noise += d * d;
+    }
+    return 10 * log10(signal / SDL_max(noise, 1e-30));
+}
+
+int main(int argc, char *argv[])
+{
+    // the sample counts SDL hands the callback, both channels of a stereo buffer
+    int sizes[] = { 512, 2048, 8192 };
+    int voiceCounts[] = { 1, 8, 32 };
+    double rates[] = { 1.0, 1.5, 2.0 };
+    int mixerFrames[] = { 64, 128, 256, 512, 1024, 2048, 4096, 8192 };
+    int mixerVoices[] = { 1, 4, 16, 64, 256 };
+    float pitches[] = { 0.0f, 0.25f, 0.5f, 0.75f, 0.99f }; // pitchShift runs from 0 to 0.99
+    int spatialFrames[] = { 256, 4096 };
+    int virtualVoices[] = { 16, 32, 64, 256, 1024 };
+    float impulseSeconds[] = { 0.5f, 1.0f, 2.0f, 3.0f }; // a small room up to the factory
+    int reverbBlocks[] = { 256, 512, 1024 };
+    int filterVoices[] = { 1, 4, 8, 32 };
+    int adpcmVoices[] = { 1, 8, 32, 64 };
+    int cullCounts[] = { 1000, 10000, 100000 };
+    int streamWindows[] = { 4096, STREAM_WINDOW_FRAMES };
+    double streamSpeeds[] = { 1, 4, 16, 0 };
+    double seconds = argc > 1 ? atof(argv[1]) : 0.5;
+    const char *suite = argc > 2 ? argv[2] : "all";
+    int all = strcmp(suite, "all") == 0;
+    int i, j, k, p;
+
+    if (SDL_Init(0) < 0)
+    {
+        printf("SDL could not initialize! SDL Error: %s\n", SDL_GetError());
+        return 0;
+    }
+
+    srand(1);
+    for (i = 0; i < BENCH_SOURCE_SAMPLES; ++i)
+    {
+        benchSource[i] = (rand() & 0xffff) - 0x8000;
+        benchSourceF32[i] = benchSource[i] / 32768.0f;
+    }
+
+    initMix();
+    initResample();
+    initReverb();
+    initFilter();
+    initAdpcm();
+    initCull();
+
+    const char *kernelNames[] = { "reference", "scalar", "sse2", "avx2" };
+    int kernelCount = SDL_HasAVX2() ? 4 : SDL_HasSSE2() ? 3 : 2;
+
+    if (all || strcmp(suite, "kernels") == 0)
+    {
+        // s16 mixes each voice into the 16 bit stream like the mixer used to,
+        // f32 mixes into the float bus and converts with dither once.
+        // the reference row is SDL_MixAudioFormat, there is no float version
+        printf("best mix kernels: %s\n", mixKernelName());
+        printf("%-8s %-7s %-10s %-14s %s\n", "samples", "voices", "kernels", "s16 samples/s", "f32 samples/s");
+        for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+            for (j = 0; j < sizeof(voiceCounts) / sizeof(voiceCounts[0]); ++j)
+                for (k = 0; k < kernelCount; ++k)
+                {
+                    double s16 = benchPipeline(pipelineS16, k, sizes[i], voiceCounts[j], seconds);
+                    if (k == 0)
+                    {
+                        printf("%-8d %-7d %-10s %-14.0f -\n", sizes[i], voiceCounts[j], kernelNames[k], s16);
+                        continue;
+                    }
+                    printf("%-8d %-7d %-10s %-14.0f %.0f\n", sizes[i], voiceCounts[j], kernelNames[k], s16,
+                        benchPipeline(pipelineF32, k, sizes[i], voiceCounts[j], seconds));
+                }
+        printf("\n");
+    }
+
+    if (all || strcmp(suite, "resample") == 0)
+    {
+        // a stereo callback buffer of 4096 frames
+        printf("%-8s %-6s %-10s %s\n", "quality", "rate", "frames/sec", "voices at 48khz");
+        for (k = 0; k < RESAMPLE_QUALITY_COUNT; ++k)
+            for (i = 0; i < sizeof(rates) / sizeof(rates[0]); ++i)
+            {
+                double fps = benchResample(k, rates[i], 4096, seconds);
+                printf("%-8s %-6.2f %-10.0f %.0f\n", resampleQualityName(k), rates[i], fps, fps / 48000);
+            }
+        printf("\n");
+    }
+
+    if (all || strcmp(suite, "mixer") == 0)
+    {
+        // the whole of mixerRender, which is all the audio callback does.
+        // voices_per_core is how many voices one core could keep up with
+        // at 48khz, if the cost per voice stayed the same
+        printf("mix_kernels,frames,voices,pitch,quality,ns_per_frame,voices_per_core\n");
+        for (k = 0; k < RESAMPLE_QUALITY_COUNT; ++k)
+            for (p = 0; p < sizeof(pitches) / sizeof(pitches[0]); ++p)
+                for (j = 0; j < sizeof(mixerVoices) / sizeof(mixerVoices[0]); ++j)
+                    for (i = 0; i < sizeof(mixerFrames) / sizeof(mixerFrames[0]); ++i)
+                    {
+                        double ns = benchMixer(mixerFrames[i], mixerVoices[j], pitches[p], k, 0, 0, NULL, MIXER_MAX_VOICES, seconds, NULL, NULL);
+                        printf("%s,%d,%d,%.2f,%s,%.2f,%.1f\n", mixKernelName(), mixerFrames[i], mixerVoices[j],
+                            pitches[p], resampleQualityName(k), ns, mixerVoices[j] * 1e9 / 48000 / ns);
+                        fflush(stdout);
+                    }
+    }
+
+    if (all || strcmp(suite, "spatial") == 0)
+    {
+        // what positioning costs on top of plain playback, as the whole
+        // render and as the per voice work at the start of each buffer
+        printf("%smix_kernels,frames,voices,plain_ns_per_frame,spatial_ns_per_frame,plain_ns_per_voice_per_buffer,spatial_ns_per_voice_per_buffer\n", all ? "\n" : "");
+        for (j = 0; j < sizeof(mixerVoices) / sizeof(mixerVoices[0]); ++j)
+            for (i = 0; i < sizeof(spatialFrames) / sizeof(spatialFrames[0]); ++i)
+            {
+                double plainVoice, spatialVoice;
+                double plain = benchMixer(spatialFrames[i], mixerVoices[j], 0.5f, RESAMPLE_CUBIC, 0, 0, NULL, MIXER_MAX_VOICES, seconds, &plainVoice, NULL);
+                double spatial = benchMixer(spatialFrames[i], mixerVoices[j], 0.5f, RESAMPLE_CUBIC, 1, 0, NULL, MIXER_MAX_VOICES, seconds, &spatialVoice, NULL);
+                printf("%s,%d,%d,%.2f,%.2f,%.1f,%.1f\n", mixKernelName(), spatialFrames[i], mixerVoices[j],
+                    plain, spatial, plainVoice, spatialVoice);
+                fflush(stdout);
+            }
+    }
+
+    if (all || strcmp(suite, "virtual") == 0)
+    {
+        // a battle of moving tanks with only the loudest MIXER_REAL_VOICES
+        // mixed. the cost should stay flat as the tanks multiply
+        printf("%smix_kernels,frames,voices,real_voices,mixed_voices,ns_per_frame\n", all ? "\n" : "");
+        for (j = 0; j < sizeof(virtualVoices) / sizeof(virtualVoices[0]); ++j)
+        {
+            int mixed;
+            double ns = benchMixer(1024, virtualVoices[j], 0.5f, RESAMPLE_CUBIC, 1, 0, NULL, MIXER_REAL_VOICES, seconds, NULL, &mixed);
+            printf("%s,%d,%d,%d,%d,%.2f\n", mixKernelName(), 1024, virtualVoices[j], MIXER_REAL_VOICES, mixed, ns);
+            fflush(stdout);
+        }
+    }
+
+    if (all || strcmp(suite, "reverb") == 0)
+    {
+        // the send bus through the convolution reverb. ms_per_second is
+        // the cpu time one second of audio costs, so percent_of_core is
+        // a tenth of it
+        ComplexMacFunc macs[] = { complexMacScalar, complexMacSSE2, complexMacAVX2 };
+        printf("%smac_kernel,impulse_seconds,block_frames,partitions,ns_per_frame,ms_per_second,percent_of_core\n", all ? "\n" : "");
+        for (k = 1; k < kernelCount; ++k)
+            for (i = 0; i < sizeof(impulseSeconds) / sizeof(impulseSeconds[0]); ++i)
+                for (j = 0; j < sizeof(reverbBlocks) / sizeof(reverbBlocks[0]); ++j)
+                {
+                    int partitions;
+                    double ns = benchReverb(macs[k - 1], impulseSeconds[i], reverbBlocks[j], seconds, &partitions);
+                    printf("%s,%.1f,%d,%d,%.2f,%.2f,%.2f\n", kernelNames[k], impulseSeconds[i], reverbBlocks[j],
+                        partitions, ns, ns * 48000 / 1e6, ns * 48000 / 1e7);
+                    fflush(stdout);
+                }
+    }
+
+    if (all || strcmp(suite, "filter") == 0)
+    {
+        // voices with two filter stages against the same voices without.
+        // a mix block is MIX_BLOCK samples, so MIX_BLOCK / BENCH_CHANNELS
+        // frames of every voice
+        FilterBankFunc banks[] = { filterBankScalar, filterBankSSE2, filterBankAVX2 };
+        FilterBankFunc best = filterBank;
+        int blockFrames = MIX_BLOCK / BENCH_CHANNELS;
+        printf("%sfilter_kernel,frames,voices,plain_ns_per_frame,filtered_ns_per_frame,filter_ns_per_voice_per_block\n", all ? "\n" : "");
+        for (k = 1; k < kernelCount; ++k)
+            for (j = 0; j < sizeof(filterVoices) / sizeof(filterVoices[0]); ++j)
+            {
+                double plain, filtered;
+                filterBank = banks[k - 1];
+                plain = benchMixer(1024, filterVoices[j], 0.5f, RESAMPLE_CUBIC, 0, 0, NULL, MIXER_MAX_VOICES, seconds, NULL, NULL);
+                filtered = benchMixer(1024, filterVoices[j], 0.5f, RESAMPLE_CUBIC, 0, 1, NULL, MIXER_MAX_VOICES, seconds, NULL, NULL);
+                printf("%s,%d,%d,%.2f,%.2f,%.1f\n", kernelNames[k], 1024, filterVoices[j], plain, filtered,
+                    (filtered - plain) * blockFrames / filterVoices[j]);
+                fflush(stdout);
+            }
+        filterBank = best;
+    }
+
+    if (all || strcmp(suite, "adpcm") == 0)
+    {
+        // what the source costs to hold in each format, and how close to
+        // it it decodes. the noise is as hard as it gets for adpcm, the
+        // tone is more like a real sound
+        static float tone[BENCH_SOURCE_SAMPLES];
+        Sample sources[2] = { { benchSourceF32, BENCH_SOURCE_FRAMES, BENCH_CHANNELS }, { tone, BENCH_SOURCE_FRAMES, BENCH_CHANNELS } };
+        const char *sourceNames[] = { "noise", "tone" };
+        AdpcmSample compressed[2];
+        AdpcmDecodeFunc decoders[] = { decodeAdpcmScalar, decodeAdpcmSSE2, decodeAdpcmAVX2 };
+        AdpcmDecodeFunc best = decodeAdpcm;
+        int blockFrames = MIX_BLOCK / BENCH_CHANNELS;
+        size_t floatBytes = BENCH_SOURCE_SAMPLES * sizeof(float);
+
+        for (i = 0; i < BENCH_SOURCE_FRAMES; ++i)
+            for (j = 0; j < BENCH_CHANNELS; ++j)
+                tone[i * BENCH_CHANNELS + j] = 0.5f * sinf(i * (j + 1) * 2 * (float)M_PI * 220 / 48000);
+
+        printf("%ssource,format,bytes,bits_per_sample,ratio_to_float,snr_db\n", all ? "\n" : "");
+        for (i = 0; i < 2; ++i)
+        {
+            size_t bytes;
+            encodeAdpcm(&compressed[i], &sources[i], 48000);
+            bytes = compressed[i].blocks * compressed[i].channels * ADPCM_BLOCK_BYTES;
+            printf("%s,float,%lu,32.00,1.00,-\n", sourceNames[i], (unsigned long)floatBytes);
+            printf("%s,s16,%lu,16.00,%.2f,%.1f\n", sourceNames[i], (unsigned long)(floatBytes / 2), 0.5,
+                s16Snr(sources[i].data, BENCH_SOURCE_SAMPLES));
+            printf("%s,adpcm,%lu,%.2f,%.3f,%.1f\n", sourceNames[i], (unsigned long)bytes,
+                bytes * 8.0 / BENCH_SOURCE_SAMPLES, (double)bytes / floatBytes, adpcmSnr(&compressed[i], sources[i].data));
+        }
+
+        // decoding on its own, and as part of the mix against the same
+        // voices playing pcm. a mix block needs about one decoded block
+        // per voice at pitch 0.5
+        printf("\ndecode_kernel,ns_per_sample,ns_per_block\n");
+        for (k = 1; k < kernelCount; ++k)
+        {
+            double ns = benchDecode(decoders[k - 1], &compressed[1], seconds);
+            printf("%s,%.3f,%.1f\n", kernelNames[k], ns, ns * ADPCM_BLOCK_FRAMES);
+            fflush(stdout);
+        }
+
+        printf("\ndecode_kernel,frames,voices,pcm_ns_per_frame,adpcm_ns_per_frame,decode_ns_per_voice_per_block\n");
+        for (k = 1; k < kernelCount; ++k)
+            for (j = 0; j < sizeof(adpcmVoices) / sizeof(adpcmVoices[0]); ++j)
+            {
+                double pcm, adpcm;
+                decodeAdpcm = decoders[k - 1];
+                pcm = benchMixer(1024, adpcmVoices[j], 0.5f, RESAMPLE_CUBIC, 0, 0, NULL, MIXER_MAX_VOICES, seconds, NULL, NULL);
+                adpcm = benchMixer(1024, adpcmVoices[j], 0.5f, RESAMPLE_CUBIC, 0, 0, &compressed[1], MIXER_MAX_VOICES, seconds, NULL, NULL);
+                printf("%s,%d,%d,%.2f,%.2f,%.1f\n", kernelNames[k], 1024, adpcmVoices[j], pcm, adpcm,
+                    (adpcm - pcm) * blockFrames / adpcmVoices[j]);
+                fflush(stdout);
+            }
+        decodeAdpcm = best;
+        freeAdpcm(&compressed[0]);
+        freeAdpcm(&compressed[1]);
+    }
+
+    if (all || strcmp(suite, "cull") == 0)
+    {
+        // spheres scattered around a camera like the game's, about a third
+        // of them in view. every kernel has to keep the same ones
+        CullFunc cullers[] = { cullSpheresScalar, cullSpheresSSE2, cullSpheresAVX2 };
+        mat4_t clip = m4_mul(m4_perspective(60, 4.0f / 3, 1, 1000),
+            m4_look_at(vec3(0, -50, 20), vec3(0, 0, 0), vec3(0, 0, 1)));
+        Frustum f;
+        CullSet s;
+        int *expected;
+
+        frustumFromMatrix(&f, clip);
+        printf("%skernel,spheres,visible,ns_per_sphere,matches_scalar\n", all ? "\n" : "");
+        for (j = 0; j < sizeof(cullCounts) / sizeof(cullCounts[0]); ++j)
+        {
+            initCullSet(&s, cullCounts[j]);
+            s.count = cullCounts[j];
+            expected = malloc(s.count * sizeof(int));
+            srand(1);
+            for (i = 0; i < s.count; ++i)
+            {
+                s.x[i] = (rand() % 2000 - 1000) * 0.25f;
+                s.y[i] = (rand() % 2000 - 1000) * 0.25f;
+                s.z[i] = (rand() % 200 - 100) * 0.25f;
+                s.radius[i] = 0.5f + (rand() % 100) * 0.02f;
+            }
+            int expectedCount = cullSpheresScalar(&f, s.x, s.y, s.z, s.radius, s.count, expected);
+            for (k = 1; k < kernelCount; ++k)
+            {
+                int visible;
+                double ns = benchCull(cullers[k - 1], &f, &s, seconds, &visible);
+                int matches = visible == expectedCount && memcmp(s.visible, expected, visible * sizeof(int)) == 0;
+                printf("%s,%d,%d,%.3f,%s\n", kernelNames[k], s.count, visible, ns, matches ? "yes" : "no");
+                fflush(stdout);
+            }
+            free(expected);
+            freeCullSet(&s);
+        }
+    }
+
+    if (all || strcmp(suite, "stream") == 0)
+    {
+        // truck_idle.wav read from disk as it plays, paced like a device
+        // and then faster, until the reader can't keep up. the window is
+        // all of it that is ever in memory. speed 0 is as fast as it can
+        printf("%swindow_frames,ring_kb,speed,buffers,underruns\n", all ? "\n" : "");
+        for (i = 0; i < sizeof(streamWindows) / sizeof(streamWindows[0]); ++i)
+            for (j = 0; j < sizeof(streamSpeeds) / sizeof(streamSpeeds[0]); ++j)
+            {
+                int buffers, ringFrames;
+                int underruns = benchStream("truck_idle.wav", streamWindows[i], 1024, streamSpeeds[j], seconds, &buffers, &ringFrames);
+                if (underruns < 0)
+                    break;
+                printf("%d,%.1f,%g,%d,%d\n", streamWindows[i], ringFrames * BENCH_CHANNELS * sizeof(float) / 1024.0,
+                    streamSpeeds[j], buffers, underruns);
+                fflush(stdout);
+            }
+    }
+
+    SDL_Quit();
+    return 0;
+}
@@ -0,0 +1,245 @@
+#include <stdio.h>
+
+#include "cache.h"
+
+#define FNV_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
+static Uint32 fnv1a(const void *data, size_t length, Uint32 hash)
+{
+    const Uint8 *p = data;
+    size_t i;
+    for (i = 0; i < length; ++i)
+    {
+        hash ^= p[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static size_t sampleBytes(const Sample *s)
+{
+    return s->frames * s->channels * sizeof(float);
+}
+
+static Uint32 contentHash(const Sample *s)
+{
+    Uint32 hash = fnv1a(&s->channels, sizeof(s->channels), FNV_BASIS);
+    return fnv1a(s->data, sampleBytes(s), hash);
+}
+
+void initSampleCache(SampleCache *c, int freq)
+{
+    SDL_memset(c, 0, sizeof(SampleCache));
+    c->freq = freq;
+}
+
+void freeSampleCache(SampleCache *c)
+{
+    int i;
+    for (i = 0; i < CACHE_MAX_SAMPLES; ++i)
+        if (c->entries[i].refs > 0 && c->entries[i].owner < 0)
+            freeSample(&c->entries[i].sample);
+    SDL_memset(c->entries, 0, sizeof(c->entries));
+}
+
+static int findName(SampleCache *c, const char *name, Uint32 nameHash)
+{
+    int i;
+    for (i = 0; i < CACHE_MAX_SAMPLES; ++i)
+    {
+        CachedSample *e = &c->entries[i];
+        if (e->refs > 0 && e->nameHash == nameHash && SDL_strcmp(e->name, name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+// an entry that owns the same frames as s. the hash only narrows it down
+static int findContent(SampleCache *c, const Sample *s, Uint32 hash)
+{
+    int i;
+    for (i = 0; i < CACHE_MAX_SAMPLES; ++i)
+    {
+        CachedSample *e = &c->entries[i];
+        if (e->refs > 0 && e->owner < 0 && e->hash == hash &&
+            e->sample.channels == s->channels && e->sample.frames == s->frames &&
+            SDL_memcmp(e->sample.data, s->data, sampleBytes(s)) == 0)
+            return i;
+    }
+    return -1;
+}
+
+// takes over s as a new entry, or borrows the data of one that has the
+// same frames and frees s
+static int insert(SampleCache *c, const char *name, Uint32 nameHash, Sample *s)
+{
+    CachedSample *e;
+    int slot;
+
+    for (slot = 0; slot < CACHE_MAX_SAMPLES; ++slot)
+        if (c->entries[slot].refs == 0)
+            break;
+    if (slot == CACHE_MAX_SAMPLES)
+    {
+        printf("Sample cache is full, can't add %s\n", name);
+        freeSample(s);
+        return -1;
+    }
+
+    e = &c->entries[slot];
+    SDL_strlcpy(e->name, name, CACHE_NAME_LENGTH);
+    e->nameHash = nameHash;
+    e->hash = contentHash(s);
+    e->refs = 1;
+    e->owner = findContent(c, s, e->hash);
+    if (e->owner >= 0)
+    {
+        c->entries[e->owner].refs++;
+        e->sample = c->entries[e->owner].sample;
+        freeSample(s);
+    }
+    else
+    {
+        e->sample = *s;
+        s->data = NULL;
+        s->frames = 0;
+    }
+    return slot;
+}
+
+int acquireSample(SampleCache *c, const char *path)
+{
+    Uint32 nameHash = fnv1a(path, SDL_strlen(path), FNV_BASIS);
+    int slot = findName(c, path, nameHash);
+    Sample s;
+
+    if (slot >= 0)
+    {
+        c->entries[slot].refs++;
+        return slot;
+    }
+    if (!loadSample(&s, path, c->freq))
+        return -1;
+    return insert(c, path, nameHash, &s);
+}
+
+int addSample(SampleCache *c, const char *name, Sample *s)
+{
+    Uint32 nameHash = fnv1a(name, SDL_strlen(name), FNV_BASIS);
+    int slot = findName(c, name, nameHash);
+
+    if (slot >= 0)
+    {
+        freeSample(s);
+        c->entries[slot].refs++;
+        return slot;
+    }
+    return insert(c, name, nameHash, s);
+}
+
+void retainSample(SampleCache *c, int handle)
+{
+    if (handle >= 0 && c->entries[handle].refs > 0)
+        c->entries[handle].refs++;
+}
+
+void releaseSample(SampleCache *c, int handle)
+{
+    CachedSample *e;
+    if (handle < 0 || c->entries[handle].refs == 0)
+        return;
+
+    e = &c->entries[handle];
+    if (--e->refs > 0)
+        return;
+    if (e->owner >= 0)
+        releaseSample(c, e->owner);
+    else
+        freeSample(&e->sample);
+    e->sample.data = NULL;
+    e->owner = -1;
+}
+
+const Sample *cachedSample(SampleCache *c, int handle)
+{
+    if (handle < 0 || c->entries[handle].refs == 0)
+        return NULL;
+    return &c->entries[handle].sample;
+}
+
+int playCached(SampleCache *c, Mixer *m, int handle, float volume, float rate, int loop)
+{
+    return playCachedAt(c, m, handle, volume, rate, loop, 0);
+}
+
+int playCachedAt(SampleCache *c, Mixer *m, int handle, float volume, float rate, int loop, Uint64 time)
+{
+    const Sample *s = cachedSample(c, handle);
+    int voice;
+    if (!s)
+        return -1;
+    if (c->voiceCount == CACHE_MAX_VOICES)
+        reapCachedVoices(c, m);
+    if (c->voiceCount == CACHE_MAX_VOICES)
+        return -1;
+
+    voice = mixerPlayAt(m, s, volume, rate, loop, time);
+    if (voice < 0)
+        return -1;
+    retainSample(c, handle);
+    c->voices[c->voiceCount] = voice;
+    c->voiceSamples[c->voiceCount] = handle;
+    ++c->voiceCount;
+    return voice;
+}
+
+void reapCachedVoices(SampleCache *c, Mixer *m)
+{
+    int i = 0;
+    while (i < c->voiceCount)
+    {
+        if (!mixerVoiceDone(m, c->voices[i]))
+        {
+            ++i;
+            continue;
+        }
+        releaseSample(c, c->voiceSamples[i]);
+        --c->voiceCount;
+        c->voices[i] = c->voices[c->voiceCount];
+        c->voiceSamples[i] = c->voiceSamples[c->voiceCount];
+    }
+}
+
+void printSampleCache(SampleCache *c)
+{
+    size_t held = 0, unshared = 0;
+    int i, j;
+
+    printf("sample cache:\n");
+    for (i = 0; i < CACHE_MAX_SAMPLES; ++i)
+    {
+        CachedSample *e = &c->entries[i];
+        size_t bytes = sampleBytes(&e->sample);
+        int users = e->refs;
+        if (e->refs == 0)
+            continue;
+
+        // the references borrowers hold aren't users of their own
+        for (j = 0; j < CACHE_MAX_SAMPLES; ++j)
+            if (c->entries[j].refs > 0 && c->entries[j].owner == i)
+                --users;
+
+        if (e->owner >= 0)
+            printf("  %-24s %d ch %8lu frames %6.2f s %9.1f kb %4d refs, the same as %s\n", e->name, e->sample.channels,
+                e->sample.frames, (double)e->sample.frames / c->freq, 0.0, users, c->entries[e->owner].name);
+        else
+        {
+            printf("  %-24s %d ch %8lu frames %6.2f s %9.1f kb %4d refs\n", e->name, e->sample.channels,
+                e->sample.frames, (double)e->sample.frames / c->freq, bytes / 1024.0, users);
+            held += bytes;
+        }
+        unshared += users * bytes;
+    }
+    printf("  %.1f kb held, %.1f kb if every reference had its own copy\n", held / 1024.0, unshared / 1024.0);
+}
@@ -0,0 +1,78 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <SDL.h>
+
+#include "mixer.h"
+#include "sample.h"
+
+#define CACHE_MAX_SAMPLES 256
+#define CACHE_NAME_LENGTH 64
+// voices playing cached samples. a stopped slot can be played again
+// before the audio thread has ended the voice in it, so there is room
+// for more than the mixer has
+#define CACHE_MAX_VOICES (MIXER_MAX_VOICES * 2)
+
+typedef struct
+{
+    char name[CACHE_NAME_LENGTH]; // the path it was loaded from
+    Uint32 nameHash;
+    Uint32 hash; // of the converted frames
+    Sample sample;
+    int refs; // 0 when the slot is free
+    // another entry whose frames turned out to be the same. this one
+    // borrows its data and holds a reference on it
+    int owner;
+} CachedSample;
+
+// every sound the game plays, loaded once and converted to the mixer's
+// format, however many voices play it. entries are found by name first,
+// then by what they hold, so two files with the same frames share one
+// copy too. game thread only
+typedef struct
+{
+    int freq;
+    CachedSample entries[CACHE_MAX_SAMPLES];
+    // voices started with playCached and the handle each holds a
+    // reference on until the mixer is done with it
+    int voices[CACHE_MAX_VOICES];
+    int voiceSamples[CACHE_MAX_VOICES];
+    int voiceCount;
+} SampleCache;
+
+void initSampleCache(SampleCache *c, int freq);
+
+// frees everything, whatever its references. the mixer can't be playing
+// any of it any more
+void freeSampleCache(SampleCache *c);
+
+// returns a handle to the wav file at path with a reference on it, loading
+// it the first time. -1 if it can't be loaded or the cache is full
+int acquireSample(SampleCache *c, const char *path);
+
+// takes over a sample made in code under name, like acquireSample. if
+// name is already cached s is freed and the cached one used
+int addSample(SampleCache *c, const char *name, Sample *s);
+
+// another reference on a handle, for something else that plays it
+void retainSample(SampleCache *c, int handle);
+
+// the data goes with the last reference. voices started with playCached
+// hold their own, so a sample can be released while they play it
+void releaseSample(SampleCache *c, int handle);
+
+const Sample *cachedSample(SampleCache *c, int handle);
+
+// like mixerPlay and mixerPlayAt, with a reference on handle for as long
+// as the voice plays it
+int playCached(SampleCache *c, Mixer *m, int handle, float volume, float rate, int loop);
+int playCachedAt(SampleCache *c, Mixer *m, int handle, float volume, float rate, int loop, Uint64 time);
+
+// drops the references of voices the mixer has ended. once a frame
+void reapCachedVoices(SampleCache *c, Mixer *m);
+
+// each sample's size and references, and what the references would cost
+// if each had its own copy
+void printSampleCache(SampleCache *c);
+
+#endif
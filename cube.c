@@ -4,6 +4,7 @@
 #include <SDL_opengl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define MAX(x, y) (((x) > (y)) ? (x) : (y))
 #define MIN(x, y) (((x) < (y)) ? (x) : (y))
@@ -11,8 +12,22 @@
 
 #define MATH_3D_IMPLEMENTATION
 #include "math_3d.h"
+// the mixer includes it too, only the first include can have the code
+#undef MATH_3D_IMPLEMENTATION
 #include "tank.h"
 #include "landscape.h"
+#include "mix.h"
+#include "mixer.h"
+#include "offline.h"
+#include "ahead.h"
+#include "cache.h"
+#include "output.h"
+#include "instance.h"
+#include "mesh.h"
+#include "batch.h"
+#include "cull.h"
+#include "queue.h"
+#include "render.h"
 
 #define SCREEN_WIDTH 640
 #define SCREEN_HEIGHT 480
@@ -23,36 +38,116 @@
 #define FPS 30
 #define TICKS_PER_SECOND ((float)1000 / (float)FPS)
 
+// attribute locations, the same in every program so they can share vaos.
+// the mvp is a mat4 and takes four
+#define VERTEX_POSITION_LOCATION 0
+#define VERTEX_MVP_LOCATION 1
+
+// slots of the instance buffer. the landscape comes first and then every
+// tank, the player's first
+#define INSTANCE_LANDSCAPE 0
+#define INSTANCE_TANKS 1
+
+// passes of the render queue, drawn in this order. the landscape has the
+// orthographic camera
+#define PASS_SCENE 0
+#define PASS_ORTHO 1
+
+// the other tanks are parked in rows this far apart in front of the camera
+#define CROWD_SPACING 3.0f
+
+// the device format. samples are converted to this rate when they load
+#define AUDIO_FREQ 48000
+#define AUDIO_CHANNELS 2
+#define AUDIO_SAMPLES 4096
+// how far ahead the queue backend keeps the device by default. the game
+// thread only tops it up once a frame, so it has to cover a frame or two
+#define AUDIO_QUEUE_MS 80
+#define REVERB_BLOCK 512
+
+// played instead of the wav when it has been made with --encode
+#define ENGINE_ADPCM "truck_idle.ima"
+// a looping track streamed from disk under everything else
+#define AMBIENCE_VOLUME 0.3f
+
+// the engine's low-pass opens up this many octaves from idle at full load
+#define ENGINE_IDLE_CUTOFF 1000.0f
+#define ENGINE_LOAD_OCTAVES 4.0f
+#define OCCLUSION_SPEED 4.0f // how fast sounds muffle and clear, per second
+#define TREAD_SPACING 0.5f // the treads clank every this many units
+
+// the enclosed levels in blend/. the impulses are made up until we have
+// recordings of the real places
+typedef struct
+{
+    const char *name;
+    float seconds;
+    float decay; // to -60 db
+} Room;
+
+Room gRooms[] = {
+    { "training center", 1.5f, 1.2f },
+    { "factory", 3.0f, 2.5f }
+};
+#define ROOM_COUNT (int)(sizeof(gRooms) / sizeof(gRooms[0]))
+
 
 int init();
 int initGL();
+int initAudio();
+void freeAudio();
 void initTank();
+void initView();
+mat4_t crowdModel(int i, int count, float seconds);
+void placeCrowd(mat4_t *mvps, int count, float seconds);
+float viewDepth(mat4_t view, vec3_t p);
 void update(float dt);
-void render();
+void renderList(const RenderList *l, void *userdata);
 void close();
 void printProgramLog( GLuint program );
 void printShaderLog( GLuint shader );
-void my_audio_callback(void *userdata, unsigned char *stream, int len);
+void renderAudio(void *userdata, Sint16 *stream, int frames, Uint64 time, int queued);
 
 SDL_Window* gWindow = NULL;
 SDL_GLContext gContext;
 
-SDL_AudioSpec want, have;
-SDL_AudioDeviceID dev;
+AudioOutput gOutput;
+const char *gAudioDriver = NULL; // SDL's choice
+int gOutputBackend = OUTPUT_CALLBACK;
+int gQueueMs = AUDIO_QUEUE_MS;
+
+SampleCache gCache;
+int gEngineSample = -1;
+int gClankSample = -1;
+AdpcmSample gEngineAdpcm;
 
-SDL_AudioSpec wav_spec;
-unsigned long wav_length;
-unsigned char *wav_buffer; 
+Mixer gMixer;
+int gEngineVoice = -1;
+const char *gAmbiencePath = NULL; // no ambience
+SampleStream *gAmbience = NULL;
+Reverb *gReverbs[ROOM_COUNT];
+int gRoom = -1; // outside
+RenderAhead *gRenderAhead = NULL; // set when the mixer runs on its own thread
+int gAheadMs = -1;
 
-unsigned char *audio_pos; // global pointer to the audio buffer to be played
-unsigned long audio_len; // remaining length of the sample we have to play
+// the simulation tick runs from gLastTickTime to gTickTime, performance
+// counter values
+Uint64 gTickTime;
+Uint64 gLastTickTime;
 
 GLuint gProgramID = 0;
-GLint gVertexPos3DLocation = -1;
+GLuint gUniformProgramID = 0; // the mvp as a uniform, a draw an object
 GLint gMVPMatrixLocation = -1;
-GLuint gVBO = 0;
-GLuint gIBO = 0;
-GLuint gVAO = 0;
+GLuint gVAO = 0; // every mesh and instance
+MeshRegistry gMeshes;
+int gTankMesh = -1;
+int gLandscapeMesh = -1;
+DrawBatch gBatch;
+RenderQueue gQueue;
+InstanceBuffer gInstances;
+Renderer gRenderer;
+int gRenderThread = 1; // 0 draws on the game thread
+int gPrintRender = 0; // the next frame prints the renderer's stats once drawn
 
 unsigned char *keys;
 int quit = 0;
@@ -73,64 +168,32 @@ float gPlayerInputRot = 0;
 
 vec3_t gTankPosition;
 float gTankRotZ;
-mat4_t gTankMVPMat;
 mat4_t gTankModelMat;
+int gTankCount = 1; // the player's and the parked ones
+float gCrowdTime = 0;
+mat4_t *gTankModels = NULL; // every tank's, the player's first
+CullSet gTankCull; // every tank's bounds, in the same order
+CullSet gLandscapeCull;
 
-mat4_t gLandscapeMVPMat;
 mat4_t gLandscapeModelMat;
 
 float pitchShift = 0;
+float gOcclusion = 0;
+float gTreadDistance = 0;
 float volume = 1.0f;
 
-#define PITCH_TABLE_ROWS 16
-#define PITCH_TABLE_COLS 32
-
-unsigned long pitchTable[] = {
-     0x0,
-     0x80000000,
-     0x80008000,
-     0x80808000,
-     0x80808080,
-     0x88808080,
-     0x88888080,
-     0x88888880,
-     0x88888888,
-     0xa8888888,
-     0xaa888888,
-     0xaaa88888,
-     0xaaaa8888,
-     0xaaaaa888,
-     0xaaaaaa88,
-     0xaaaaaaa8
-};
-    
-
-void my_audio_callback(void *userdata, unsigned char *stream, int len) {
-    SDL_memset(stream, 0, len);
-    int count = 0;
-    
-    int i = 0;
-    while (i < len)
+// what either output backend renders, on the audio thread or the game's
+void renderAudio(void *userdata, Sint16 *stream, int frames, Uint64 time, int queued) {
+    Mixer *mixer = userdata;
+    if (gRenderAhead)
+        readRenderAhead(gRenderAhead, stream, frames, queued);
+    else
     {
-        ++count;
-        count = count % PITCH_TABLE_COLS;
-        int f = PITCH_TABLE_ROWS * pitchShift;
-        int bitmask = pitchTable[f];
-        int skip = bitmask & (1 << count);
-        if (!skip) {
-            // is copying one itty bitty byte of data at a time bad practice?
-            SDL_MixAudio(stream+i, audio_pos, 2, SDL_MIX_MAXVOLUME * volume);
-            i += 2;
-        }      
-        
-        audio_pos += 2;
-        audio_len -= 2; 
-        
-        if (audio_len == 0) 
-        {
-            audio_len = wav_length;
-            audio_pos = wav_buffer;
-        }
+        // the device was queued frames from the first of these at time.
+        // timed sounds go out the output's latency after their time, which
+        // is as far ahead as anything gets rendered
+        mixerSetClock(mixer, time, mixer->frame - queued, gOutput.latency);
+        mixerRender(mixer, stream, frames);
     }
 }
 
@@ -142,8 +205,6 @@ int init()
 		printf( "SDL could not initialize! SDL Error: %s\n", SDL_GetError() );
 		return 0;
 	}
-    
-    SDL_AudioInit("directsound");
 	
     SDL_GL_SetAttribute( SDL_GL_CONTEXT_MAJOR_VERSION, 3 );
     SDL_GL_SetAttribute( SDL_GL_CONTEXT_MINOR_VERSION, 3 );
@@ -179,21 +240,20 @@ int init()
         printf( "Unable to initialize OpenGL!\n" );
         return 0;
     }
+    initCull();
 
 	return 1;
 }
 
-int initGL()
+// compiles vertexShaderSource with the one fragment shader there is and
+// links them. returns 0 if either doesn't compile or they don't link
+GLuint buildProgram( const GLchar *vertexShaderSource )
 {
-	gProgramID = glCreateProgram();
+	GLuint program = glCreateProgram();
     
     // vertex shader
 	GLuint vertexShader = glCreateShader( GL_VERTEX_SHADER );
-	const GLchar* vertexShaderSource[] =
-	{
-		"#version 140\nin vec3 LVertexPos3D;\nuniform mat4 mvp;\n void main() { vec4 pos = vec4(LVertexPos3D, 1);\n pos = mvp * pos;\n gl_Position = pos; }"
-	};
-	glShaderSource( vertexShader, 1, vertexShaderSource, NULL );
+	glShaderSource( vertexShader, 1, &vertexShaderSource, NULL );
 	glCompileShader( vertexShader );
 
 	// check for errors
@@ -206,7 +266,7 @@ int initGL()
         return 0;
 	}
     
-    glAttachShader( gProgramID, vertexShader );
+    glAttachShader( program, vertexShader );
 
     // fragment shader
     GLuint fragmentShader = glCreateShader( GL_FRAGMENT_SHADER );
@@ -227,31 +287,42 @@ int initGL()
         return 0;
     }
     
-    glAttachShader( gProgramID, fragmentShader );
+    glAttachShader( program, fragmentShader );
+
+    // the same locations in every program. names a shader doesn't have
+    // are ignored
+    glBindAttribLocation( program, VERTEX_POSITION_LOCATION, "LVertexPos3D" );
+    glBindAttribLocation( program, VERTEX_MVP_LOCATION, "LMVP" );
 
     //Link program
-    glLinkProgram( gProgramID );
+    glLinkProgram( program );
 
     //Check for errors
     GLint programSuccess = GL_TRUE;
-    glGetProgramiv( gProgramID, GL_LINK_STATUS, &programSuccess );
+    glGetProgramiv( program, GL_LINK_STATUS, &programSuccess );
     if( programSuccess != GL_TRUE )
     {
-        printf( "Error linking program %d!\n", gProgramID );
-        printProgramLog( gProgramID );
+        printf( "Error linking program %d!\n", program );
+        printProgramLog( program );
         return 0;
     }
-        
-    //Get vertex attribute location
-    gVertexPos3DLocation = glGetAttribLocation( gProgramID, "LVertexPos3D" );
-    if( gVertexPos3DLocation == -1 )
-    {
-        printf( "LVertexPos3D is not a valid glsl program variable!\n" );
+    
+    return program;
+}
+
+int initGL()
+{
+    // every object's mvp comes from the instance it is
+    gProgramID = buildProgram(
+        "#version 140\nin vec3 LVertexPos3D;\nin mat4 LMVP;\n void main() { vec4 pos = vec4(LVertexPos3D, 1);\n pos = LMVP * pos;\n gl_Position = pos; }" );
+    // the way objects used to be drawn, kept to measure against
+    gUniformProgramID = buildProgram(
+        "#version 140\nin vec3 LVertexPos3D;\nuniform mat4 mvp;\n void main() { vec4 pos = vec4(LVertexPos3D, 1);\n pos = mvp * pos;\n gl_Position = pos; }" );
+    if( !gProgramID || !gUniformProgramID )
         return 0;
-    }
     
     //Get model matrix location
-    gMVPMatrixLocation = glGetUniformLocation( gProgramID, "mvp" );
+    gMVPMatrixLocation = glGetUniformLocation( gUniformProgramID, "mvp" );
     if( gMVPMatrixLocation == -1 )
     {
         printf( "mvp is not a valid glsl program variable!\n" );
@@ -261,54 +332,120 @@ int initGL()
     //Initialize clear color
     glClearColor( 0.f, 0.f, 0.f, 1.f );
 
-    // VAO
-    glGenVertexArrays(1, &gVAO);
-    glBindVertexArray(gVAO);
+    // meshes
+    initMeshRegistry( &gMeshes );
+    gTankMesh = addMesh( &gMeshes, tankVertexData, TANK_NUM_VERTEX / 3, tankEdgeData, TANK_NUM_EDGE );
+    gLandscapeMesh = addMesh( &gMeshes, landscapeVertexData, LANDSCAPE_NUM_VERTEX / 3, landscapeEdgeData, LANDSCAPE_NUM_EDGE );
+    if( gTankMesh < 0 || gLandscapeMesh < 0 )
+        return 0;
     
-    //Create VBO
-    glGenBuffers( 1, &gVBO );
-    glBindBuffer( GL_ARRAY_BUFFER, gVBO );
-    glBufferData( GL_ARRAY_BUFFER, TANK_VERTEX_DATA_SIZE + LANDSCAPE_VERTEX_DATA_SIZE, NULL, GL_STATIC_DRAW );
-    glBufferSubData( GL_ARRAY_BUFFER, 0, TANK_VERTEX_DATA_SIZE, tankVertexData);
-    glBufferSubData( GL_ARRAY_BUFFER, TANK_VERTEX_DATA_SIZE, LANDSCAPE_VERTEX_DATA_SIZE, landscapeVertexData);
+    // the transforms, written every frame
+    initInstanceBuffer( &gInstances, INSTANCE_TANKS + gTankCount, 1 );
     
-    // shader input
-    glEnableVertexAttribArray( gVertexPos3DLocation );
-    glVertexAttribPointer( gVertexPos3DLocation, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), NULL );
+    // VAO. one for every mesh, they share the buffers
+    glGenVertexArrays( 1, &gVAO );
+    glBindVertexArray( gVAO );
+    bindMeshBuffers( &gMeshes, VERTEX_POSITION_LOCATION );
+    bindInstanceAttribute( &gInstances, VERTEX_MVP_LOCATION );
+    glBindVertexArray( 0 );
     
-    //Create IBO
-    glGenBuffers( 1, &gIBO );
-    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, gIBO );
-    glBufferData( GL_ELEMENT_ARRAY_BUFFER, TANK_EDGE_DATA_SIZE + LANDSCAPE_EDGE_DATA_SIZE, NULL, GL_STATIC_DRAW );
-    glBufferSubData( GL_ELEMENT_ARRAY_BUFFER, 0, TANK_EDGE_DATA_SIZE, tankEdgeData);
-    glBufferSubData( GL_ELEMENT_ARRAY_BUFFER, TANK_EDGE_DATA_SIZE, LANDSCAPE_EDGE_DATA_SIZE, landscapeEdgeData);
-
-    glBindVertexArray(0);
+    initDrawBatch( &gBatch );
+    initRenderQueue( &gQueue );
     
 	return 1;
 }
 
-void initTank()
+int initAudio()
 {
-    // load audio
-    if (SDL_LoadWAV("truck_idle.wav", &wav_spec, &wav_buffer, &wav_length) == NULL) {
-        printf("Could not open truck_idle.wav: %s\n", SDL_GetError());
+    // load audio. the engine plays from the compressed copy if there is
+    // one, and only loads the wav when there isn't
+    initSampleCache(&gCache, AUDIO_FREQ);
+    SDL_RWops *compressed = SDL_RWFromFile(ENGINE_ADPCM, "rb");
+    if (compressed)
+        SDL_RWclose(compressed);
+    if (!compressed || !loadAdpcm(&gEngineAdpcm, ENGINE_ADPCM))
+    {
+        gEngineSample = acquireSample(&gCache, "truck_idle.wav");
+        if (gEngineSample < 0)
+            return 0;
     }
 
-    wav_spec.callback = my_audio_callback;
-    wav_spec.userdata = NULL;
+    initMix();
+    initResample();
+    initReverb();
+    initFilter();
+    initAdpcm();
+    initMixer(&gMixer, AUDIO_FREQ, AUDIO_CHANNELS);
+    // a short burst of noise does for metal on metal
+    Sample clank;
+    if (makeImpulse(&clank, AUDIO_FREQ, 0.06f, 0.04f, 7))
+        gClankSample = addSample(&gCache, "clank", &clank);
     
-    audio_pos = wav_buffer;
-    audio_len = wav_length;
-    
-    if ( SDL_OpenAudio(&wav_spec, NULL) < 0 ){
-	  printf("Couldn't open audio: %s\n", SDL_GetError());
-	  exit(-1);
+    for (int i = 0; i < ROOM_COUNT; ++i)
+    {
+        Sample impulse;
+        // a room without one just sounds dry
+        if (!makeImpulse(&impulse, AUDIO_FREQ, gRooms[i].seconds, gRooms[i].decay, i + 1))
+            continue;
+        gReverbs[i] = createReverb(&impulse, REVERB_BLOCK, 0.3f);
+        freeSample(&impulse);
     }
     
-    SDL_PauseAudio(0);
+    // the tank engine loops for as long as the game runs, decoded as it
+    // plays if there is a compressed copy
+    if (gEngineSample < 0)
+        gEngineVoice = mixerPlayAdpcm(&gMixer, &gEngineAdpcm, volume, 1.0, 1);
+    else
+        gEngineVoice = playCached(&gCache, &gMixer, gEngineSample, volume, 1.0, 1);
+    // the player's own tank is never dropped for a louder one
+    mixerSetPriority(&gMixer, gEngineVoice, 1);
+    mixerSetSend(&gMixer, gEngineVoice, 0.5f);
     
+    return 1;
+}
+
+// once nothing can be playing any more
+void freeAudio()
+{
+    releaseSample(&gCache, gEngineSample);
+    releaseSample(&gCache, gClankSample);
+    freeSampleCache(&gCache);
+    freeAdpcm(&gEngineAdpcm);
+    for (int i = 0; i < ROOM_COUNT; ++i)
+        if (gReverbs[i])
+            freeReverb(gReverbs[i]);
+}
+
+void initTank()
+{
+    initAudio();
     
+    // only the window of the track is ever in memory, however long it is
+    if (gAmbiencePath)
+    {
+        gAmbience = openStream(gAmbiencePath, STREAM_WINDOW_FRAMES, 1);
+        if (gAmbience)
+            mixerPlayStream(&gMixer, gAmbience, AMBIENCE_VOLUME, (float)gAmbience->freq / AUDIO_FREQ);
+    }
+    
+    // the most the device takes at once plus the extra latency asked for
+    int queueFrames = gQueueMs * AUDIO_FREQ / 1000;
+    int burst = gOutputBackend == OUTPUT_QUEUE ? queueFrames + OUTPUT_QUEUE_BLOCK : AUDIO_SAMPLES;
+    if (!openAudioOutput(&gOutput, gAudioDriver, gOutputBackend, AUDIO_FREQ, AUDIO_CHANNELS, AUDIO_SAMPLES,
+        queueFrames, renderAudio, &gMixer))
+        exit(-1);
+    // the device is still paused, so nothing renders before the thread
+    // takes the mixer over
+    if (gAheadMs >= 0)
+        gRenderAhead = startRenderAhead(&gMixer, burst + gAheadMs * AUDIO_FREQ / 1000, gOutput.latency);
+    startAudioOutput(&gOutput);
+    
+    initView();
+}
+
+// the cameras, and the objects where they start
+void initView()
+{
     // perspective projection and view matrix
     proj = m4_perspective(FOV, ASPECT_RATIO, NEAR, FAR);
     
@@ -334,10 +471,70 @@ void initTank()
     gTankModelMat = m4_identity();
     
     gLandscapeModelMat = m4_identity();
+    
+    // where they are is worked out every frame
+    gTankModels = malloc( gTankCount * sizeof(mat4_t) );
+    initCullSet( &gTankCull, gTankCount );
+    initCullSet( &gLandscapeCull, 1 );
+}
+
+// the model matrix of the i'th of count tanks other than the player's,
+// parked in rows ahead of it and turning on the spot at a few different
+// speeds
+mat4_t crowdModel(int i, int count, float seconds)
+{
+    int columns = (int)ceilf(sqrtf(count));
+    vec3_t position = vec3((i % columns - (columns - 1) / 2.0f) * CROWD_SPACING, (i / columns + 2) * CROWD_SPACING, 0);
+    return m4_mul(m4_translation(position), m4_rotation_z(seconds * (0.2f + 0.1f * (i % 7))));
+}
+
+// how far in front of a camera a point is, 0 at the near plane and 1 at
+// the far one
+float viewDepth(mat4_t view, vec3_t p)
+{
+    return (-m4_mul_pos(view, p).z - NEAR) / (FAR - NEAR);
+}
+
+// the mvps of all of them
+void placeCrowd(mat4_t *mvps, int count, float seconds)
+{
+    for (int i = 0; i < count; ++i)
+        mvps[i] = m4_mul(pv, crowdModel(i, count, seconds));
+}
+
+// 1 if the landscape is between from and to, else 0. the landscape is a
+// profile of hills standing in its y = 0 plane with z up, so it blocks
+// the line where it crosses that plane under the profile
+float landscapeOcclusion(vec3_t from, vec3_t to)
+{
+    mat4_t toModel = m4_invert_affine(gLandscapeModelMat);
+    vec3_t a = m4_mul_pos(toModel, from);
+    vec3_t b = m4_mul_pos(toModel, to);
+    
+    if ((a.y > 0) == (b.y > 0))
+        return 0;
+    
+    float t = a.y / (a.y - b.y);
+    float x = a.x + (b.x - a.x) * t;
+    float z = a.z + (b.z - a.z) * t;
+    for (int i = 0; i < LANDSCAPE_NUM_EDGE; i += 2)
+    {
+        const GLfloat *p = landscapeVertexData + landscapeEdgeData[i] * 3;
+        const GLfloat *q = landscapeVertexData + landscapeEdgeData[i + 1] * 3;
+        if (p[0] == q[0] || x < MIN(p[0], q[0]) || x > MAX(p[0], q[0]))
+            continue;
+        if (z < p[2] + (q[2] - p[2]) * (x - p[0]) / (q[0] - p[0]))
+            return 1;
+    }
+    return 0;
 }
 
 void update(float dt)
 {
+    // the frame's draws are recorded into a list while the render thread
+    // is still drawing the last one
+    RenderList *list = beginFrame(&gRenderer);
+    
     // parse player input
     // https://wiki.libsdl.org/SDL_Scancode
     
@@ -375,10 +572,63 @@ void update(float dt)
     // tank matrix
     gTankModelMat = m4_translation(gTankPosition);
     gTankModelMat = m4_mul(gTankModelMat, m4_rotation_z(gTankRotZ));
-    gTankMVPMat = m4_mul(pv, gTankModelMat);
+    
+    // the parked tanks turn on the spot
+    gCrowdTime += dt;
+    
+    // every tank's bounds, moved with it. turning doesn't change a
+    // sphere's radius
+    const Mesh *tank = registeredMesh(&gMeshes, gTankMesh);
+    for (int i = 0; i < gTankCount; ++i)
+    {
+        gTankModels[i] = i == 0 ? gTankModelMat : crowdModel(i - 1, gTankCount - 1, gCrowdTime);
+        vec3_t center = m4_mul_pos(gTankModels[i], tank->center);
+        gTankCull.x[i] = center.x;
+        gTankCull.y[i] = center.y;
+        gTankCull.z[i] = center.z;
+        gTankCull.radius[i] = tank->radius;
+    }
+    gTankCull.count = gTankCount;
+    
+    // the landscape has a camera of its own
+    const Mesh *landscape = registeredMesh(&gMeshes, gLandscapeMesh);
+    vec3_t landscapeCenter = m4_mul_pos(gLandscapeModelMat, landscape->center);
+    gLandscapeCull.x[0] = landscapeCenter.x;
+    gLandscapeCull.y[0] = landscapeCenter.y;
+    gLandscapeCull.z[0] = landscapeCenter.z;
+    gLandscapeCull.radius[0] = landscape->radius;
+    gLandscapeCull.count = 1;
+    
+    // only what the cameras see gets a slot and is drawn
+    Frustum frustum;
+    frustumFromMatrix(&frustum, pv);
+    int visibleTanks = cullSet(&gTankCull, &frustum);
+    frustumFromMatrix(&frustum, pv_ortho);
+    cullSet(&gLandscapeCull, &frustum);
+    
+    // the tanks are drawn together, as near as the nearest of them
+    float tankDepth = 1;
+    for (int i = 0; i < visibleTanks; ++i)
+    {
+        int k = gTankCull.visible[i];
+        tankDepth = SDL_min(tankDepth, viewDepth(view, vec3(gTankCull.x[k], gTankCull.y[k], gTankCull.z[k])));
+    }
+    
+    // every visible object's matrix for the frame goes into its slot, the
+    // visible tanks one after the other
+    mat4_t *matrices = listMatrices(list, INSTANCE_TANKS + visibleTanks);
+    for (int i = 0; i < visibleTanks; ++i)
+        matrices[INSTANCE_TANKS + i] = m4_mul(pv, gTankModels[gTankCull.visible[i]]);
     
     // landscape matrix
-    gLandscapeMVPMat = m4_mul(pv_ortho, gLandscapeModelMat);
+    matrices[INSTANCE_LANDSCAPE] = m4_mul(pv_ortho, gLandscapeModelMat);
+    
+    listMesh(list, gTankMesh, PASS_SCENE, tankDepth, INSTANCE_TANKS, visibleTanks);
+    listMesh(list, gLandscapeMesh, PASS_ORTHO, viewDepth(view_ortho, landscapeCenter), INSTANCE_LANDSCAPE,
+        gLandscapeCull.visibleCount);
+    if (gPrintRender)
+        listStats(list);
+    gPrintRender = 0;
     
 
     // audio stuff
@@ -391,37 +641,117 @@ void update(float dt)
         pitchShift = MAX(pitchShift, 0.0f);
     }
     
-    // tank volume
-    float k = CLAMP(gTankPosition.y, 0, 20);
-    volume = 1.0f - k / 20.0f;
+    // the engine is heard from the camera, which doesn't move
+    mixerSetListener(&gMixer, view, vec3(0, 0, 0));
+    mixerSetEmitter(&gMixer, gEngineVoice, gTankPosition, dt > 0 ? v3_divs(velocity, dt) : vec3(0, 0, 0));
+    mixerSetRate(&gMixer, gEngineVoice, 1.0 + pitchShift);
+    
+    // the engine sounds duller idling than working
+    float load = CLAMP(0.7f * pitchShift + 0.3f * fabsf(gPlayerInputY), 0.0f, 1.0f);
+    BiquadSettings engineFilter = { FILTER_LOW_PASS, ENGINE_IDLE_CUTOFF * powf(2, ENGINE_LOAD_OCTAVES * load), 0.7071f, 0 };
+    mixerSetFilter(&gMixer, gEngineVoice, 0, &engineFilter);
+    
+    // muffled behind the hills, easing in and out rather than snapping
+    vec3_t camera = m4_mul_pos(m4_invert_affine(view), vec3(0, 0, 0));
+    float occlusion = landscapeOcclusion(camera, gTankPosition);
+    gOcclusion += CLAMP(occlusion - gOcclusion, -OCCLUSION_SPEED * dt, OCCLUSION_SPEED * dt);
+    mixerSetOcclusion(&gMixer, gEngineVoice, gOcclusion);
+    
+    // clanks that have played out let go of the sample
+    reapCachedVoices(&gCache, &gMixer);
+    
+    // a clank every TREAD_SPACING units, timed to where in the tick the
+    // tank got there. the tick is simulated once it is over, so the
+    // clanks go out a tick after they happened
+    float step = v3_length(velocity);
+    gTreadDistance += step;
+    while (step > 0 && gTreadDistance >= TREAD_SPACING)
+    {
+        gTreadDistance -= TREAD_SPACING;
+        float along = 1 - gTreadDistance / step;
+        Uint64 time = gTickTime + (Uint64)(along * (gTickTime - gLastTickTime));
+        int clank = playCachedAt(&gCache, &gMixer, gClankSample, 0.2f, 1.0f, 0, time);
+        mixerSetEmitter(&gMixer, clank, gTankPosition, vec3(0, 0, 0));
+    }
+    
+    endFrame(&gRenderer);
 }
 
-void render()
+// draws a frame update recorded. on the render thread, which is the only
+// one that touches gl once the game is running
+void renderList(const RenderList *l, void *userdata)
 {
-	glClear( GL_COLOR_BUFFER_BIT );
+    int stats = 0;
     
-    glUseProgram( gProgramID );
-    glBindVertexArray(gVAO);
-    
-    // tank
-    glUniformMatrix4fv(gMVPMatrixLocation, 1, GL_FALSE, &gTankMVPMat);
-    glDrawElementsBaseVertex( GL_LINES, TANK_NUM_EDGE, GL_UNSIGNED_INT, NULL, 0 );
+	glClear( GL_COLOR_BUFFER_BIT );
     
-    // landscape
-    glUniformMatrix4fv(gMVPMatrixLocation, 1, GL_FALSE, &gLandscapeMVPMat);
-    glDrawElementsBaseVertex( GL_LINES, LANDSCAPE_NUM_EDGE, GL_UNSIGNED_INT, (void*)TANK_EDGE_DATA_SIZE, TANK_NUM_VERTEX / 3);
+    // the transforms update recorded, into this frame's slots
+    uploadInstances(&gInstances, l->matrices, l->matrixCount);
     
+    // the draws go in in any order. the queue sorts them by pass and
+    // state, binds what changes and sends each run with the same program
+    // and vao out in one submit, however many objects there are
+    beginRenderQueue(&gQueue);
+    for (int i = 0; i < l->commandCount; ++i)
+    {
+        const RenderCommand *c = &l->commands[i];
+        if (c->type == RENDER_MESH)
+            queueMesh(&gQueue, renderKey(c->pass, gProgramID, gVAO, c->mesh, c->depth), gProgramID, gVAO,
+                registeredMesh(&gMeshes, c->mesh), c->first, c->count);
+        else if (c->type == RENDER_STATS)
+            stats = 1;
+    }
+    sortRenderQueue(&gQueue);
+    submitRenderQueue(&gQueue, &gBatch, &gInstances);
+    fenceInstances(&gInstances);
+    glBindVertexArray(0);
     glUseProgram( 0 );
 
     SDL_GL_SwapWindow( gWindow );
+    
+    if (stats)
+    {
+        printMeshRegistry(&gMeshes);
+        printDrawBatch(&gBatch);
+        printRenderQueue(&gQueue);
+        printInstanceBuffer(&gInstances);
+        printRenderer(&gRenderer);
+    }
 }
 
 void close()
 {
-    SDL_FreeWAV(wav_buffer);
-    wav_buffer = NULL;
+    closeAudioOutput(&gOutput);
+    printAudioOutput(&gOutput);
+    printf("late timed sounds: %d\n", SDL_AtomicGet(&gMixer.lateCommands));
+    printSampleCache(&gCache);
+    if (gRenderAhead)
+    {
+        printRenderAhead(gRenderAhead);
+        stopRenderAhead(gRenderAhead);
+        gRenderAhead = NULL;
+    }
+    // nothing is mixing it any more
+    if (gAmbience)
+    {
+        printf("ambience underruns: %d\n", SDL_AtomicGet(&gAmbience->underruns));
+        closeStream(gAmbience);
+        gAmbience = NULL;
+    }
+    freeAudio();
     
+    // gl comes back to this thread
+    stopRenderer(&gRenderer);
+    printRenderer(&gRenderer);
 	glDeleteProgram( gProgramID );
+	glDeleteProgram( gUniformProgramID );
+    freeInstanceBuffer(&gInstances);
+    freeMeshRegistry(&gMeshes);
+    freeDrawBatch(&gBatch);
+    free(gTankModels);
+    gTankModels = NULL;
+    freeCullSet(&gTankCull);
+    freeCullSet(&gLandscapeCull);
     
 	SDL_DestroyWindow( gWindow );
 	gWindow = NULL;
@@ -472,8 +802,244 @@ void printShaderLog( GLuint shader )
 		printf( "Name %d is not a shader\n", shader );
 }
 
+// cube --render out.wav automation.txt
+// runs the audio on its own, with no window or audio device
+int renderMain(int argc, char *argv[])
+{
+    static Automation automation;
+    
+    if (argc < 4)
+    {
+        printf("usage: %s --render out.wav automation.txt\n", argv[0]);
+        return 1;
+    }
+    
+    if (SDL_Init(0) < 0)
+    {
+        printf("SDL could not initialize! SDL Error: %s\n", SDL_GetError());
+        return 1;
+    }
+    
+    int ok = loadAutomation(&automation, argv[3]) && initAudio()
+        && renderOffline(&gMixer, gEngineVoice, AUDIO_SAMPLES, &automation, argv[2]);
+    
+    freeAudio();
+    SDL_Quit();
+    return ok ? 0 : 1;
+}
+
+// cube --encode in.wav out.ima
+// compresses a sound at the mixer's rate for it to decode as it plays
+int encodeMain(int argc, char *argv[])
+{
+    Sample sample;
+    AdpcmSample compressed;
+    
+    if (argc < 4)
+    {
+        printf("usage: %s --encode in.wav out.ima\n", argv[0]);
+        return 1;
+    }
+    
+    if (SDL_Init(0) < 0)
+    {
+        printf("SDL could not initialize! SDL Error: %s\n", SDL_GetError());
+        return 1;
+    }
+    
+    int ok = loadSample(&sample, argv[2], AUDIO_FREQ);
+    if (ok)
+    {
+        SDL_zero(compressed);
+        ok = encodeAdpcm(&compressed, &sample, AUDIO_FREQ) && saveAdpcm(&compressed, argv[3]);
+        if (ok)
+            printf("%s: %lu frames, %.1f kb as float, %.1f kb as 16 bit, %.1f kb compressed\n", argv[3],
+                sample.frames, sample.frames * sample.channels * sizeof(float) / 1024.0,
+                sample.frames * sample.channels * sizeof(Sint16) / 1024.0,
+                compressed.blocks * compressed.channels * ADPCM_BLOCK_BYTES / 1024.0);
+        freeAdpcm(&compressed);
+        freeSample(&sample);
+    }
+    
+    SDL_Quit();
+    return ok ? 0 : 1;
+}
+
+// cube --draw-bench [seconds]
+// frame times of drawing 1 to 10k tanks the way the game used to, a
+// uniform and a draw each, in one instanced draw with the transforms
+// streamed into fresh storage and written into the mapped ring, and a
+// draw command each in one batch, as if every tank were a different mesh,
+// and queued back to front for the render queue to sort and batch.
+// frames overlap like in the game, and the clock stops once the last one
+// is finished so the gpu's share is counted too
+int drawBenchMain(int argc, char *argv[])
+{
+    int counts[] = { 1, 100, 1000, 10000 };
+    const char *paths[] = { "uniform", "streamed", "ring", "batched", "queued" };
+    int maxCount = counts[sizeof(counts) / sizeof(counts[0]) - 1];
+    double seconds = argc > 2 ? atof(argv[2]) : 1.0;
+    Uint64 freq = SDL_GetPerformanceFrequency();
+    
+    if( !init() )
+    {
+        printf( "Failed to initialize!\n" );
+        return 1;
+    }
+    initView();
+    // as many frames as it can draw
+    SDL_GL_SetSwapInterval(0);
+    
+    mat4_t *mvps = malloc((INSTANCE_TANKS + maxCount) * sizeof(mat4_t));
+    mvps[INSTANCE_LANDSCAPE] = m4_identity();
+    const Mesh *tank = registeredMesh(&gMeshes, gTankMesh);
+    
+    // the same vao for transforms that never go through the ring
+    InstanceBuffer streamed;
+    GLuint streamedVAO;
+    initInstanceBuffer(&streamed, INSTANCE_TANKS + maxCount, 0);
+    glGenVertexArrays(1, &streamedVAO);
+    glBindVertexArray(streamedVAO);
+    bindMeshBuffers(&gMeshes, VERTEX_POSITION_LOCATION);
+    bindInstanceAttribute(&streamed, VERTEX_MVP_LOCATION);
+    glBindVertexArray(0);
+    
+    printf("renderer: %s\n", glGetString(GL_RENDERER));
+    printf("path,instances,frames,calls_per_frame,submit_ms,frame_ms\n");
+    for (int i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i)
+        for (int p = 0; p < sizeof(paths) / sizeof(paths[0]); ++p)
+        {
+            int calls = 1;
+            int frames = -1; // the first one warms up
+            Uint64 submit = 0, start = 0, end = SDL_GetPerformanceCounter() + (Uint64)(seconds * freq);
+            while (frames < 0 || SDL_GetPerformanceCounter() < end)
+            {
+                SDL_PumpEvents();
+                Uint64 frameStart = SDL_GetPerformanceCounter();
+                if (frames == 0)
+                    start = frameStart;
+                
+                placeCrowd(mvps + INSTANCE_TANKS, counts[i], frames / (float)FPS);
+                Uint64 submitStart = SDL_GetPerformanceCounter();
+                glClear( GL_COLOR_BUFFER_BIT );
+                if (p == 0)
+                {
+                    glUseProgram( gUniformProgramID );
+                    glBindVertexArray(gVAO);
+                    for (int j = 0; j < counts[i]; ++j)
+                    {
+                        glUniformMatrix4fv(gMVPMatrixLocation, 1, GL_FALSE, (GLfloat*)&mvps[INSTANCE_TANKS + j]);
+                        glDrawElementsBaseVertex( GL_LINES, tank->indexCount, GL_UNSIGNED_INT,
+                            (void*)(tank->firstIndex * sizeof(GLuint)), tank->firstVertex );
+                    }
+                    calls = counts[i];
+                }
+                else if (p == 1)
+                {
+                    glUseProgram( gProgramID );
+                    uploadInstances(&streamed, mvps, INSTANCE_TANKS + counts[i]);
+                    glBindVertexArray(streamedVAO);
+                    drawMesh(tank, &streamed, INSTANCE_TANKS, counts[i]);
+                }
+                else if (p == 2)
+                {
+                    glUseProgram( gProgramID );
+                    uploadInstances(&gInstances, mvps, INSTANCE_TANKS + counts[i]);
+                    glBindVertexArray(gVAO);
+                    drawMesh(tank, &gInstances, INSTANCE_TANKS, counts[i]);
+                    fenceInstances(&gInstances);
+                }
+                else if (p == 3)
+                {
+                    glUseProgram( gProgramID );
+                    uploadInstances(&gInstances, mvps, INSTANCE_TANKS + counts[i]);
+                    beginDrawBatch(&gBatch);
+                    for (int j = 0; j < counts[i]; ++j)
+                        batchMesh(&gBatch, tank, INSTANCE_TANKS + j, 1);
+                    glBindVertexArray(gVAO);
+                    submitDrawBatch(&gBatch, &gInstances);
+                    fenceInstances(&gInstances);
+                    calls = gBatch.calls;
+                }
+                else
+                {
+                    // the rows go away from the camera
+                    uploadInstances(&gInstances, mvps, INSTANCE_TANKS + counts[i]);
+                    beginRenderQueue(&gQueue);
+                    for (int j = counts[i] - 1; j >= 0; --j)
+                        queueMesh(&gQueue, renderKey(PASS_SCENE, gProgramID, gVAO, gTankMesh, j / (float)counts[i]),
+                            gProgramID, gVAO, tank, INSTANCE_TANKS + j, 1);
+                    sortRenderQueue(&gQueue);
+                    submitRenderQueue(&gQueue, &gBatch, &gInstances);
+                    fenceInstances(&gInstances);
+                    calls = gQueue.calls;
+                }
+                glBindVertexArray(0);
+                glUseProgram( 0 );
+                if (frames >= 0)
+                    submit += SDL_GetPerformanceCounter() - submitStart;
+                
+                SDL_GL_SwapWindow( gWindow );
+                // the warm up frame is finished before the clock starts
+                if (frames < 0)
+                    glFinish();
+                ++frames;
+            }
+            glFinish();
+            Uint64 elapsed = SDL_GetPerformanceCounter() - start;
+            printf("%s,%d,%d,%d,%.3f,%.3f\n", paths[p], counts[i], frames, calls,
+                submit * 1000.0 / freq / SDL_max(frames, 1), elapsed * 1000.0 / freq / SDL_max(frames, 1));
+        }
+    
+    printInstanceBuffer(&gInstances);
+    printRenderQueue(&gQueue);
+    free(mvps);
+    glDeleteVertexArrays(1, &streamedVAO);
+    freeInstanceBuffer(&streamed);
+	glDeleteProgram( gProgramID );
+	glDeleteProgram( gUniformProgramID );
+    freeInstanceBuffer(&gInstances);
+    freeMeshRegistry(&gMeshes);
+    freeDrawBatch(&gBatch);
+	SDL_DestroyWindow( gWindow );
+	gWindow = NULL;
+    SDL_Quit();
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {    
+    if (argc > 1 && strcmp(argv[1], "--render") == 0)
+        return renderMain(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "--encode") == 0)
+        return encodeMain(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "--draw-bench") == 0)
+        return drawBenchMain(argc, argv);
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        // --ahead ms mixes on its own thread, ms ahead of the device
+        if (strcmp(argv[i], "--ahead") == 0)
+            gAheadMs = SDL_max(atoi(argv[i + 1]), 0);
+        // --driver name picks SDL's audio driver, like disk or dummy
+        else if (strcmp(argv[i], "--driver") == 0)
+            gAudioDriver = argv[i + 1];
+        // --queue ms pushes audio from the game thread, ms ahead
+        else if (strcmp(argv[i], "--queue") == 0)
+        {
+            gOutputBackend = OUTPUT_QUEUE;
+            gQueueMs = SDL_max(atoi(argv[i + 1]), 1);
+        }
+        // --tanks n draws n tanks, the player's and n - 1 parked ones
+        else if (strcmp(argv[i], "--tanks") == 0)
+            gTankCount = SDL_max(atoi(argv[i + 1]), 1);
+        // --ambience file.wav streams a 16 bit wav on a loop under the game
+        else if (strcmp(argv[i], "--ambience") == 0)
+            gAmbiencePath = argv[i + 1];
+        // --render-thread 0 draws on the game thread, after each tick
+        else if (strcmp(argv[i], "--render-thread") == 0)
+            gRenderThread = atoi(argv[i + 1]) != 0;
+    }
+    
 	if( !init() )
     {
 		printf( "Failed to initialize!\n" );
@@ -483,13 +1049,19 @@ int main(int argc, char *argv[])
     
     initTank();
     keys = SDL_GetKeyboardState(NULL);
+    // gl is the render thread's from here
+    startRenderer(&gRenderer, gWindow, gContext, gRenderThread, renderList, NULL);
     
     SDL_Event e;
     unsigned int frameTicks = 0;
     float dt = 0;
+    gTickTime = SDL_GetPerformanceCounter();
     
     while( !quit )
     {
+        gLastTickTime = gTickTime;
+        gTickTime = SDL_GetPerformanceCounter();
+
         int ticks = SDL_GetTicks();
         dt = ticks - frameTicks;
         frameTicks = ticks;
@@ -501,10 +1073,39 @@ int main(int argc, char *argv[])
         {
             if (e.type == SDL_QUIT)
                 quit = 1;
+            else if (e.type == SDL_KEYDOWN && e.key.keysym.sym >= SDLK_1 && e.key.keysym.sym < SDLK_1 + RESAMPLE_QUALITY_COUNT)
+            {
+                int quality = e.key.keysym.sym - SDLK_1;
+                mixerSetQuality(&gMixer, quality);
+                printf("resampler: %s\n", resampleQualityName(quality));
+            }
+            else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_r)
+            {
+                // outside, then each room in turn
+                gRoom = gRoom + 1 < ROOM_COUNT ? gRoom + 1 : -1;
+                mixerSetReverb(&gMixer, gRoom >= 0 ? gReverbs[gRoom] : NULL);
+                printf("room: %s\n", gRoom >= 0 ? gRooms[gRoom].name : "outside");
+            }
+            else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_t)
+            {
+                printAudioOutput(&gOutput);
+                printf("late timed sounds: %d\n", SDL_AtomicGet(&gMixer.lateCommands));
+                printSampleCache(&gCache);
+                if (gAmbience)
+                    printf("ambience underruns: %d\n", SDL_AtomicGet(&gAmbience->underruns));
+                printCullSet(&gTankCull, "tank");
+                printCullSet(&gLandscapeCull, "landscape");
+                if (gRenderAhead)
+                    printRenderAhead(gRenderAhead);
+                // the render thread prints the rest once it draws the frame
+                gPrintRender = 1;
+            }
         }
         
+        // records the frame and hands it to the render thread
         update(dt / 1000.0f);
-        render();
+        // after update, so what it played goes out in this top up
+        pumpAudioOutput(&gOutput);
         
         // sleep
         int end = SDL_GetTicks();
@@ -0,0 +1,187 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cull.h"
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define CULL_X86
+#include <immintrin.h>
+#endif
+
+CullFunc cullSpheres = cullSpheresScalar;
+
+void frustumFromMatrix(Frustum *f, mat4_t clip)
+{
+    // a point is inside where -w <= x, y, z <= w, so each plane is the
+    // last row plus or minus one of the others
+    static const int axis[CULL_PLANES] = { 0, 0, 1, 1, 2, 2 };
+    static const float sign[CULL_PLANES] = { 1, -1, 1, -1, 1, -1 };
+    int p;
+
+    for (p = 0; p < CULL_PLANES; ++p)
+    {
+        int r = axis[p];
+        float a = clip.m[0][3] + sign[p] * clip.m[0][r];
+        float b = clip.m[1][3] + sign[p] * clip.m[1][r];
+        float c = clip.m[2][3] + sign[p] * clip.m[2][r];
+        float d = clip.m[3][3] + sign[p] * clip.m[3][r];
+        float length = sqrtf(a * a + b * b + c * c);
+        f->a[p] = a / length;
+        f->b[p] = b / length;
+        f->c[p] = c / length;
+        f->d[p] = d / length;
+    }
+}
+
+// the spheres from first on, one at a time. the sums are in the same
+// order as the vector kernels so they all keep the same spheres
+static int cullRange(const Frustum *f, const float *x, const float *y, const float *z, const float *radius, int first, int count, int *visible)
+{
+    int i, p, n = 0;
+    for (i = first; i < count; ++i)
+    {
+        int inside = 1;
+        for (p = 0; p < CULL_PLANES && inside; ++p)
+            inside = (f->a[p] * x[i] + f->b[p] * y[i]) + (f->c[p] * z[i] + f->d[p]) >= -radius[i];
+        visible[n] = i;
+        n += inside;
+    }
+    return n;
+}
+
+int cullSpheresScalar(const Frustum *f, const float *x, const float *y, const float *z, const float *radius, int count, int *visible)
+{
+    return cullRange(f, x, y, z, radius, 0, count, visible);
+}
+
+#ifdef CULL_X86
+
+__attribute__((target("sse2")))
+int cullSpheresSSE2(const Frustum *f, const float *x, const float *y, const float *z, const float *radius, int count, int *visible)
+{
+    int i, p, n = 0;
+    for (i = 0; i + 4 <= count; i += 4)
+    {
+        __m128 px = _mm_loadu_ps(x + i);
+        __m128 py = _mm_loadu_ps(y + i);
+        __m128 pz = _mm_loadu_ps(z + i);
+        __m128 limit = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+        __m128 inside = _mm_cmpeq_ps(px, px); // all set, unless x is nan
+        for (p = 0; p < CULL_PLANES; ++p)
+        {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(f->a[p]), px), _mm_mul_ps(_mm_set1_ps(f->b[p]), py)),
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(f->c[p]), pz), _mm_set1_ps(f->d[p])));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, limit));
+        }
+        int mask = _mm_movemask_ps(inside);
+        while (mask)
+        {
+            visible[n++] = i + __builtin_ctz(mask);
+            mask &= mask - 1;
+        }
+    }
+    return n + cullRange(f, x, y, z, radius, i, count, visible + n);
+}
+
+__attribute__((target("avx2")))
+int cullSpheresAVX2(const Frustum *f, const float *x, const float *y, const float *z, const float *radius, int count, int *visible)
+{
+    int i, p, n = 0;
+    for (i = 0; i + 8 <= count; i += 8)
+    {
+        __m256 px = _mm256_loadu_ps(x + i);
+        __m256 py = _mm256_loadu_ps(y + i);
+        __m256 pz = _mm256_loadu_ps(z + i);
+        __m256 limit = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(radius + i));
+        __m256 inside = _mm256_cmp_ps(px, px, _CMP_EQ_OQ);
+        for (p = 0; p < CULL_PLANES; ++p)
+        {
+            __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(f->a[p]), px), _mm256_mul_ps(_mm256_set1_ps(f->b[p]), py)),
+                _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(f->c[p]), pz), _mm256_set1_ps(f->d[p])));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, limit, _CMP_GE_OQ));
+        }
+        int mask = _mm256_movemask_ps(inside);
+        while (mask)
+        {
+            visible[n++] = i + __builtin_ctz(mask);
+            mask &= mask - 1;
+        }
+    }
+    _mm256_zeroupper();
+    return n + cullRange(f, x, y, z, radius, i, count, visible + n);
+}
+
+#else
+
+int cullSpheresSSE2(const Frustum *f, const float *x, const float *y, const float *z, const float *radius, int count, int *visible)
+{
+    return cullSpheresScalar(f, x, y, z, radius, count, visible);
+}
+
+int cullSpheresAVX2(const Frustum *f, const float *x, const float *y, const float *z, const float *radius, int count, int *visible)
+{
+    return cullSpheresScalar(f, x, y, z, radius, count, visible);
+}
+
+#endif
+
+void initCullSet(CullSet *s, int capacity)
+{
+    SDL_memset(s, 0, sizeof(CullSet));
+    s->capacity = SDL_max(capacity, 1);
+    s->x = malloc(s->capacity * sizeof(float));
+    s->y = malloc(s->capacity * sizeof(float));
+    s->z = malloc(s->capacity * sizeof(float));
+    s->radius = malloc(s->capacity * sizeof(float));
+    s->visible = malloc(s->capacity * sizeof(int));
+}
+
+void freeCullSet(CullSet *s)
+{
+    free(s->x);
+    free(s->y);
+    free(s->z);
+    free(s->radius);
+    free(s->visible);
+    SDL_memset(s, 0, sizeof(CullSet));
+}
+
+int cullSet(CullSet *s, const Frustum *f)
+{
+    Uint64 start = SDL_GetPerformanceCounter();
+    s->visibleCount = cullSpheres(f, s->x, s->y, s->z, s->radius, s->count, s->visible);
+    s->ticks += SDL_GetPerformanceCounter() - start;
+    ++s->passes;
+    s->tested += s->count;
+    s->kept += s->visibleCount;
+    return s->visibleCount;
+}
+
+void printCullSet(CullSet *s, const char *name)
+{
+    double micros = s->ticks * 1000000.0 / SDL_GetPerformanceFrequency();
+    printf("%s culling: %d visible and %d culled last frame, %.1f%% visible on average, %.2f us a pass, %.1f ns a sphere, %s\n",
+        name, s->visibleCount, s->count - s->visibleCount, s->kept * 100.0 / SDL_max(s->tested, 1),
+        micros / SDL_max(s->passes, 1), micros * 1000 / SDL_max(s->tested, 1), cullKernelName());
+}
+
+void initCull()
+{
+    cullSpheres = cullSpheresScalar;
+#ifdef CULL_X86
+    if (SDL_HasAVX2())
+        cullSpheres = cullSpheresAVX2;
+    else if (SDL_HasSSE2())
+        cullSpheres = cullSpheresSSE2;
+#endif
+}
+
+const char *cullKernelName()
+{
+    if (cullSpheres == cullSpheresAVX2)
+        return "avx2";
+    if (cullSpheres == cullSpheresSSE2)
+        return "sse2";
+    return "scalar";
+}
@@ -0,0 +1,72 @@
+#ifndef CULL_H
+#define CULL_H
+
+#include <SDL.h>
+
+#include "math_3d.h"
+
+#define CULL_PLANES 6
+
+// the planes of a view frustum, facing in and normalized, so a x + b y +
+// c z + d is how far inside a point is. a plane to an element of each
+// array so a vector holds the same plane for neighbouring spheres
+typedef struct
+{
+    float a[CULL_PLANES];
+    float b[CULL_PLANES];
+    float c[CULL_PLANES];
+    float d[CULL_PLANES];
+} Frustum;
+
+// the frustum of a projection times view (times model) matrix, in the
+// space the matrix takes points from
+void frustumFromMatrix(Frustum *f, mat4_t clip);
+
+// writes the indices of the count spheres that are at least partly inside
+// f to visible, in order, and returns how many there are. the vector
+// kernels test a sphere in each lane against all the planes at once
+typedef int (*CullFunc)(const Frustum *f, const float *x, const float *y, const float *z, const float *radius, int count, int *visible);
+
+// best kernel for this cpu, set by initCull()
+extern CullFunc cullSpheres;
+
+int cullSpheresScalar(const Frustum *f, const float *x, const float *y, const float *z, const float *radius, int count, int *visible);
+int cullSpheresSSE2(const Frustum *f, const float *x, const float *y, const float *z, const float *radius, int count, int *visible);
+int cullSpheresAVX2(const Frustum *f, const float *x, const float *y, const float *z, const float *radius, int count, int *visible);
+
+// spheres to cull, a coordinate to an array. fill in count of them, then
+// cullSet leaves the indices of the visible ones in visible
+typedef struct
+{
+    int capacity;
+    int count;
+    float *x;
+    float *y;
+    float *z;
+    float *radius;
+    int *visible;
+    int visibleCount;
+
+    // every pass so far, and the time they took
+    int passes;
+    Uint64 tested;
+    Uint64 kept;
+    Uint64 ticks;
+} CullSet;
+
+void initCullSet(CullSet *s, int capacity);
+
+void freeCullSet(CullSet *s);
+
+// culls the spheres against f and keeps count. returns how many are visible
+int cullSet(CullSet *s, const Frustum *f);
+
+// what was visible last pass and on average, and what a pass costs
+void printCullSet(CullSet *s, const char *name);
+
+// picks the kernel for this cpu
+void initCull();
+
+const char *cullKernelName();
+
+#endif
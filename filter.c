@@ -0,0 +1,220 @@
+#include <math.h>
+
+#include "filter.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define FILTER_X86
+#include <immintrin.h>
+#endif
+
+FilterBankFunc filterBank = filterBankScalar;
+
+// both stages go through each frame together, so the second stage's
+// recurrence runs alongside the first's instead of after it. b * x + z2 is
+// off the critical path, which is only y -> a * y -> z1 -> y
+void filterBankScalar(float *lanes, int frames, FilterBank *bank, int stages)
+{
+    int s, l, f;
+    for (l = 0; l < FILTER_LANES; ++l)
+    {
+        float z1[FILTER_STAGES], z2[FILTER_STAGES];
+        for (s = 0; s < stages; ++s)
+        {
+            z1[s] = bank->z1[s][l];
+            z2[s] = bank->z2[s][l];
+        }
+        for (f = 0; f < frames; ++f)
+        {
+            float x = lanes[f * FILTER_LANES + l];
+            for (s = 0; s < stages; ++s)
+            {
+                float y = bank->b0[s][l] * x + z1[s];
+                z1[s] = (bank->b1[s][l] * x + z2[s]) - bank->a1[s][l] * y;
+                z2[s] = bank->b2[s][l] * x - bank->a2[s][l] * y;
+                x = y;
+            }
+            lanes[f * FILTER_LANES + l] = x;
+        }
+        for (s = 0; s < stages; ++s)
+        {
+            bank->z1[s][l] = z1[s];
+            bank->z2[s][l] = z2[s];
+        }
+    }
+}
+
+#ifdef FILTER_X86
+
+#define BIQUAD_SSE2(x, y, s) \
+    y = _mm_add_ps(_mm_mul_ps(b0##s, x), z1##s); \
+    z1##s = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(b1##s, x), z2##s), _mm_mul_ps(a1##s, y)); \
+    z2##s = _mm_sub_ps(_mm_mul_ps(b2##s, x), _mm_mul_ps(a2##s, y));
+
+#define BIQUAD_AVX2(x, y, s) \
+    y = _mm256_add_ps(_mm256_mul_ps(b0##s, x), z1##s); \
+    z1##s = _mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(b1##s, x), z2##s), _mm256_mul_ps(a1##s, y)); \
+    z2##s = _mm256_sub_ps(_mm256_mul_ps(b2##s, x), _mm256_mul_ps(a2##s, y));
+
+// the vector kernels are written for two stages and leave a bank with
+// fewer to the scalar one
+__attribute__((target("sse2")))
+void filterBankSSE2(float *lanes, int frames, FilterBank *bank, int stages)
+{
+    int l, f;
+    if (stages < FILTER_STAGES)
+    {
+        filterBankScalar(lanes, frames, bank, stages);
+        return;
+    }
+    for (l = 0; l < FILTER_LANES; l += 4)
+    {
+        __m128 b00 = _mm_loadu_ps(&bank->b0[0][l]), b01 = _mm_loadu_ps(&bank->b0[1][l]);
+        __m128 b10 = _mm_loadu_ps(&bank->b1[0][l]), b11 = _mm_loadu_ps(&bank->b1[1][l]);
+        __m128 b20 = _mm_loadu_ps(&bank->b2[0][l]), b21 = _mm_loadu_ps(&bank->b2[1][l]);
+        __m128 a10 = _mm_loadu_ps(&bank->a1[0][l]), a11 = _mm_loadu_ps(&bank->a1[1][l]);
+        __m128 a20 = _mm_loadu_ps(&bank->a2[0][l]), a21 = _mm_loadu_ps(&bank->a2[1][l]);
+        __m128 z10 = _mm_loadu_ps(&bank->z1[0][l]), z11 = _mm_loadu_ps(&bank->z1[1][l]);
+        __m128 z20 = _mm_loadu_ps(&bank->z2[0][l]), z21 = _mm_loadu_ps(&bank->z2[1][l]);
+        for (f = 0; f < frames; ++f)
+        {
+            float *p = lanes + f * FILTER_LANES + l;
+            __m128 x = _mm_loadu_ps(p);
+            __m128 y, out;
+            BIQUAD_SSE2(x, y, 0)
+            BIQUAD_SSE2(y, out, 1)
+            _mm_storeu_ps(p, out);
+        }
+        _mm_storeu_ps(&bank->z1[0][l], z10);
+        _mm_storeu_ps(&bank->z1[1][l], z11);
+        _mm_storeu_ps(&bank->z2[0][l], z20);
+        _mm_storeu_ps(&bank->z2[1][l], z21);
+    }
+}
+
+__attribute__((target("avx2")))
+void filterBankAVX2(float *lanes, int frames, FilterBank *bank, int stages)
+{
+    int f;
+    if (stages < FILTER_STAGES)
+    {
+        filterBankScalar(lanes, frames, bank, stages);
+        return;
+    }
+    __m256 b00 = _mm256_loadu_ps(bank->b0[0]), b01 = _mm256_loadu_ps(bank->b0[1]);
+    __m256 b10 = _mm256_loadu_ps(bank->b1[0]), b11 = _mm256_loadu_ps(bank->b1[1]);
+    __m256 b20 = _mm256_loadu_ps(bank->b2[0]), b21 = _mm256_loadu_ps(bank->b2[1]);
+    __m256 a10 = _mm256_loadu_ps(bank->a1[0]), a11 = _mm256_loadu_ps(bank->a1[1]);
+    __m256 a20 = _mm256_loadu_ps(bank->a2[0]), a21 = _mm256_loadu_ps(bank->a2[1]);
+    __m256 z10 = _mm256_loadu_ps(bank->z1[0]), z11 = _mm256_loadu_ps(bank->z1[1]);
+    __m256 z20 = _mm256_loadu_ps(bank->z2[0]), z21 = _mm256_loadu_ps(bank->z2[1]);
+    for (f = 0; f < frames; ++f)
+    {
+        float *p = lanes + f * FILTER_LANES;
+        __m256 x = _mm256_loadu_ps(p);
+        __m256 y, out;
+        BIQUAD_AVX2(x, y, 0)
+        BIQUAD_AVX2(y, out, 1)
+        _mm256_storeu_ps(p, out);
+    }
+    _mm256_storeu_ps(bank->z1[0], z10);
+    _mm256_storeu_ps(bank->z1[1], z11);
+    _mm256_storeu_ps(bank->z2[0], z20);
+    _mm256_storeu_ps(bank->z2[1], z21);
+    _mm256_zeroupper();
+}
+
+#else
+
+void filterBankSSE2(float *lanes, int frames, FilterBank *bank, int stages)
+{
+    filterBankScalar(lanes, frames, bank, stages);
+}
+
+void filterBankAVX2(float *lanes, int frames, FilterBank *bank, int stages)
+{
+    filterBankScalar(lanes, frames, bank, stages);
+}
+
+#endif
+
+void makeBiquad(Biquad *b, const BiquadSettings *settings, int freq)
+{
+    // keep clear of 0 and nyquist, where the cookbook formulas fall apart
+    double cutoff = SDL_min(SDL_max(settings->cutoff, 10.0), freq * 0.49);
+    double w = 2 * M_PI * cutoff / freq;
+    double cosw = cos(w);
+    double alpha = sin(w) / (2 * SDL_max(settings->q, 0.05f));
+    double amp = pow(10, settings->gain / 40);
+    double b0, b1, b2, a0, a1, a2;
+
+    switch (settings->type)
+    {
+        case FILTER_LOW_PASS:
+            b0 = (1 - cosw) / 2;
+            b1 = 1 - cosw;
+            b2 = b0;
+            a0 = 1 + alpha;
+            a1 = -2 * cosw;
+            a2 = 1 - alpha;
+            break;
+        case FILTER_HIGH_PASS:
+            b0 = (1 + cosw) / 2;
+            b1 = -(1 + cosw);
+            b2 = b0;
+            a0 = 1 + alpha;
+            a1 = -2 * cosw;
+            a2 = 1 - alpha;
+            break;
+        case FILTER_PEAKING:
+            b0 = 1 + alpha * amp;
+            b1 = -2 * cosw;
+            b2 = 1 - alpha * amp;
+            a0 = 1 + alpha / amp;
+            a1 = -2 * cosw;
+            a2 = 1 - alpha / amp;
+            break;
+        default:
+            b0 = a0 = 1;
+            b1 = b2 = a1 = a2 = 0;
+            break;
+    }
+
+    b->b0 = (float)(b0 / a0);
+    b->b1 = (float)(b1 / a0);
+    b->b2 = (float)(b2 / a0);
+    b->a1 = (float)(a1 / a0);
+    b->a2 = (float)(a2 / a0);
+}
+
+void setBankLane(FilterBank *bank, int stage, int lane, const Biquad *b)
+{
+    bank->b0[stage][lane] = b->b0;
+    bank->b1[stage][lane] = b->b1;
+    bank->b2[stage][lane] = b->b2;
+    bank->a1[stage][lane] = b->a1;
+    bank->a2[stage][lane] = b->a2;
+}
+
+void initFilter()
+{
+    filterBank = filterBankScalar;
+#ifdef FILTER_X86
+    if (SDL_HasAVX2())
+        filterBank = filterBankAVX2;
+    else if (SDL_HasSSE2())
+        filterBank = filterBankSSE2;
+#endif
+}
+
+const char *filterKernelName()
+{
+    if (filterBank == filterBankAVX2)
+        return "avx2";
+    if (filterBank == filterBankSSE2)
+        return "sse2";
+    return "scalar";
+}
@@ -0,0 +1,71 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <SDL.h>
+
+// signals a filter bank runs at once, one voice channel in each lane
+#define FILTER_LANES 8
+
+// biquads in series on each voice
+#define FILTER_STAGES 2
+
+#define FILTER_NONE 0
+#define FILTER_LOW_PASS 1
+#define FILTER_HIGH_PASS 2
+#define FILTER_PEAKING 3
+
+// coefficients of one biquad, already divided by a0
+typedef struct
+{
+    float b0, b1, b2;
+    float a1, a2;
+} Biquad;
+
+// what a stage should be. gain only matters for peaking, in db
+typedef struct
+{
+    int type;
+    float cutoff; // hz, the centre for peaking
+    float q;
+    float gain;
+} BiquadSettings;
+
+// FILTER_STAGES biquads for each of FILTER_LANES independent signals, laid
+// out so one vector holds the same value for neighbouring lanes. the
+// filters are transposed direct form 2, z1 and z2 are the state
+typedef struct
+{
+    float b0[FILTER_STAGES][FILTER_LANES];
+    float b1[FILTER_STAGES][FILTER_LANES];
+    float b2[FILTER_STAGES][FILTER_LANES];
+    float a1[FILTER_STAGES][FILTER_LANES];
+    float a2[FILTER_STAGES][FILTER_LANES];
+    float z1[FILTER_STAGES][FILTER_LANES];
+    float z2[FILTER_STAGES][FILTER_LANES];
+} FilterBank;
+
+// filters frames frames of FILTER_LANES interleaved samples in place
+// through the first stages stages of the bank. a biquad only depends on
+// its own last outputs, so the lanes are what goes in parallel
+typedef void (*FilterBankFunc)(float *lanes, int frames, FilterBank *bank, int stages);
+
+// best kernel for this cpu, set by initFilter()
+extern FilterBankFunc filterBank;
+
+void filterBankScalar(float *lanes, int frames, FilterBank *bank, int stages);
+void filterBankSSE2(float *lanes, int frames, FilterBank *bank, int stages);
+void filterBankAVX2(float *lanes, int frames, FilterBank *bank, int stages);
+
+// the audio eq cookbook filters at sample rate freq. FILTER_NONE passes
+// the signal through unchanged
+void makeBiquad(Biquad *b, const BiquadSettings *settings, int freq);
+
+// puts b in one lane of a stage of the bank
+void setBankLane(FilterBank *bank, int stage, int lane, const Biquad *b);
+
+// picks the kernel for this cpu
+void initFilter();
+
+const char *filterKernelName();
+
+#endif
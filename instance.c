@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "instance.h"
+
+static void createStorage(InstanceBuffer *b)
+{
+    glGenBuffers(1, &b->buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, b->buffer);
+    if (b->ring)
+    {
+        // coherent, so what the cpu writes is seen without flushing
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        GLsizeiptr size = INSTANCE_RING_FRAMES * b->capacity * sizeof(mat4_t);
+        glBufferStorage(GL_ARRAY_BUFFER, size, NULL, flags);
+        b->mapped = glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+        if (b->mapped)
+            return;
+        printf("Couldn't map the instance ring, streaming instead\n");
+        glDeleteBuffers(1, &b->buffer);
+        b->ring = 0;
+        glGenBuffers(1, &b->buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, b->buffer);
+    }
+    glBufferData(GL_ARRAY_BUFFER, b->capacity * sizeof(mat4_t), NULL, GL_STREAM_DRAW);
+    b->staging = realloc(b->staging, b->capacity * sizeof(mat4_t));
+}
+
+// waits for the gpu to finish drawing from a frame of the ring
+static void waitFrame(InstanceBuffer *b, int frame)
+{
+    GLsync fence = b->fences[frame];
+    if (!fence)
+        return;
+    if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+    {
+        ++b->stalls;
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+            ;
+    }
+    glDeleteSync(fence);
+    b->fences[frame] = 0;
+}
+
+void initInstanceBuffer(InstanceBuffer *b, int capacity, int ring)
+{
+    SDL_memset(b, 0, sizeof(InstanceBuffer));
+    b->capacity = SDL_max(capacity, 1);
+    b->baseInstance = GLEW_VERSION_4_2 || GLEW_ARB_base_instance;
+    b->ring = ring && (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage);
+    createStorage(b);
+}
+
+void freeInstanceBuffer(InstanceBuffer *b)
+{
+    for (int i = 0; i < INSTANCE_RING_FRAMES; ++i)
+        if (b->fences[i])
+            glDeleteSync(b->fences[i]);
+    // deleting a mapped buffer unmaps it
+    glDeleteBuffers(1, &b->buffer);
+    b->buffer = 0;
+    b->mapped = NULL;
+    free(b->staging);
+    b->staging = NULL;
+}
+
+// a column to a location. the vao keeps the buffer, not its storage, so
+// this survives streaming into fresh storage
+static void pointAttribute(InstanceBuffer *b, int first)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, b->buffer);
+    for (int i = 0; i < 4; ++i)
+        glVertexAttribPointer(b->location + i, 4, GL_FLOAT, GL_FALSE, sizeof(mat4_t),
+            (void*)(first * sizeof(mat4_t) + i * 4 * sizeof(GLfloat)));
+    b->first = first;
+}
+
+void bindInstanceAttribute(InstanceBuffer *b, GLuint location)
+{
+    GLint vao;
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vao);
+    b->vao = vao;
+    b->location = location;
+    for (int i = 0; i < 4; ++i)
+    {
+        glEnableVertexAttribArray(location + i);
+        glVertexAttribDivisor(location + i, 1);
+    }
+    pointAttribute(b, 0);
+}
+
+// the ring's storage can't change size, so it is replaced, once the gpu
+// is done with all of it, and the vao pointed at the new buffer
+static void growInstances(InstanceBuffer *b, int count)
+{
+    b->capacity = SDL_max(count, b->capacity * 2);
+    if (!b->ring)
+    {
+        b->staging = realloc(b->staging, b->capacity * sizeof(mat4_t));
+        return;
+    }
+
+    for (int i = 0; i < INSTANCE_RING_FRAMES; ++i)
+        waitFrame(b, i);
+    glDeleteBuffers(1, &b->buffer);
+    b->mapped = NULL;
+    createStorage(b);
+
+    GLint vao;
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vao);
+    glBindVertexArray(b->vao);
+    pointAttribute(b, b->first);
+    glBindVertexArray(vao);
+}
+
+mat4_t *beginInstances(InstanceBuffer *b, int count)
+{
+    if (count > b->capacity)
+        growInstances(b, count);
+    b->count = count;
+    ++b->frames;
+    if (!b->ring)
+    {
+        b->base = 0;
+        return b->staging;
+    }
+
+    b->frame = (b->frame + 1) % INSTANCE_RING_FRAMES;
+    waitFrame(b, b->frame);
+    b->base = b->frame * b->capacity;
+    return b->mapped + b->base;
+}
+
+void endInstances(InstanceBuffer *b)
+{
+    if (b->ring)
+        return;
+    glBindBuffer(GL_ARRAY_BUFFER, b->buffer);
+    // fresh storage every frame, so the driver hands over a new block
+    // instead of waiting for last frame's draws to finish with the old one
+    glBufferData(GL_ARRAY_BUFFER, b->capacity * sizeof(mat4_t), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, b->count * sizeof(mat4_t), b->staging);
+}
+
+void fenceInstances(InstanceBuffer *b)
+{
+    if (b->ring)
+        b->fences[b->frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void uploadInstances(InstanceBuffer *b, const mat4_t *matrices, int count)
+{
+    SDL_memcpy(beginInstances(b, count), matrices, count * sizeof(mat4_t));
+    endInstances(b);
+}
+
+void drawInstances(InstanceBuffer *b, GLenum mode, int indexCount, int firstIndex, int baseVertex, int first, int count)
+{
+    const void *indices = (const void*)(firstIndex * sizeof(GLuint));
+    first += b->base;
+    if (b->baseInstance)
+    {
+        glDrawElementsInstancedBaseVertexBaseInstance(mode, indexCount, GL_UNSIGNED_INT, indices, count, baseVertex, first);
+        return;
+    }
+    if (first != b->first)
+        pointAttribute(b, first);
+    glDrawElementsInstancedBaseVertex(mode, indexCount, GL_UNSIGNED_INT, indices, count, baseVertex);
+}
+
+void printInstanceBuffer(InstanceBuffer *b)
+{
+    if (b->ring)
+        printf("instances: %d frame ring of %d matrices, mapped, %d frames, %d waited for the gpu\n",
+            INSTANCE_RING_FRAMES, b->capacity, b->frames, b->stalls);
+    else
+        printf("instances: %d matrices streamed into fresh storage, %d frames\n", b->capacity, b->frames);
+}
@@ -0,0 +1,76 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include <SDL.h>
+#include <gl\glew.h>
+
+#include "math_3d.h"
+
+// frames of transforms the ring holds. the cpu writes one while the gpu
+// can still be drawing from the other two
+#define INSTANCE_RING_FRAMES 3
+
+// per-instance transforms streamed to the gpu every frame. the vertex
+// shader reads its mvp from a mat4 attribute that steps once an instance
+// instead of from a uniform, so every copy of a mesh goes out in one draw.
+// the caller picks each frame which object goes in which slot, and a
+// frame's slots start at base in the buffer
+typedef struct
+{
+    GLuint buffer;
+    int capacity; // matrices a frame has room for
+    int count; // matrices this frame
+    int base;
+    // the drawing vao's mat4 attribute and the instance it points at now
+    GLuint vao;
+    GLuint location;
+    int first;
+    int baseInstance; // the driver can start a draw at any instance
+
+    // with buffer storage the buffer is INSTANCE_RING_FRAMES frames mapped
+    // for good, and the matrices are written straight into it. a frame's
+    // fence is signalled once the gpu is done drawing from it. without,
+    // they are written to staging and uploaded into fresh storage
+    int ring;
+    mat4_t *mapped;
+    int frame; // of the ring, being written
+    GLsync fences[INSTANCE_RING_FRAMES];
+    mat4_t *staging;
+
+    int frames;
+    int stalls; // frames that had to wait for the gpu to finish a frame
+} InstanceBuffer;
+
+// ring 0 always streams through staging, for comparing against
+void initInstanceBuffer(InstanceBuffer *b, int capacity, int ring);
+
+void freeInstanceBuffer(InstanceBuffer *b);
+
+// points the mat4 attribute at location, and the three after it, of the
+// bound vao at the matrices. that vao is the one to draw with
+void bindInstanceAttribute(InstanceBuffer *b, GLuint location);
+
+// returns where to write this frame's count matrices, in one pass and
+// slot order, growing the buffer if they don't fit. waits if the gpu is
+// still drawing from the part of the ring it comes back to
+mat4_t *beginInstances(InstanceBuffer *b, int count);
+
+// the frame's matrices are written. uploads them unless they are mapped
+void endInstances(InstanceBuffer *b);
+
+// after the last draw reading this frame's matrices, so the ring knows
+// when it can write over them
+void fenceInstances(InstanceBuffer *b);
+
+// begin, copy and end, for matrices already in an array
+void uploadInstances(InstanceBuffer *b, const mat4_t *matrices, int count);
+
+// draws count instances of indexCount indices from firstIndex on, with
+// the matrices from slot first on. gl 3.3 has no base instance, so
+// without ARB_base_instance the attribute is moved to first instead
+void drawInstances(InstanceBuffer *b, GLenum mode, int indexCount, int firstIndex, int baseVertex, int first, int count);
+
+// how the matrices get to the gpu and how often that waited
+void printInstanceBuffer(InstanceBuffer *b);
+
+#endif
@@ -0,0 +1,198 @@
+#include <stdio.h>
+
+#include "mesh.h"
+
+static void initArena(Arena *a, int capacity)
+{
+    a->capacity = capacity;
+    a->used = 0;
+    a->ranges = 1;
+    a->offsets[0] = 0;
+    a->sizes[0] = capacity;
+}
+
+static void removeRange(Arena *a, int i)
+{
+    SDL_memmove(a->offsets + i, a->offsets + i + 1, (a->ranges - i - 1) * sizeof(int));
+    SDL_memmove(a->sizes + i, a->sizes + i + 1, (a->ranges - i - 1) * sizeof(int));
+    --a->ranges;
+}
+
+// returns the offset of size units, or -1 if no range is big enough
+static int arenaAlloc(Arena *a, int size)
+{
+    for (int i = 0; i < a->ranges; ++i)
+        if (a->sizes[i] >= size)
+        {
+            int offset = a->offsets[i];
+            a->offsets[i] += size;
+            a->sizes[i] -= size;
+            if (a->sizes[i] == 0)
+                removeRange(a, i);
+            a->used += size;
+            return offset;
+        }
+    return -1;
+}
+
+static void arenaFree(Arena *a, int offset, int size)
+{
+    int i = 0;
+    while (i < a->ranges && a->offsets[i] < offset)
+        ++i;
+
+    // joined onto the free ranges either side if it touches them
+    int before = i > 0 && a->offsets[i - 1] + a->sizes[i - 1] == offset;
+    int after = i < a->ranges && offset + size == a->offsets[i];
+    if (before && after)
+    {
+        a->sizes[i - 1] += size + a->sizes[i];
+        removeRange(a, i);
+    }
+    else if (before)
+        a->sizes[i - 1] += size;
+    else if (after)
+    {
+        a->offsets[i] = offset;
+        a->sizes[i] += size;
+    }
+    else
+    {
+        SDL_memmove(a->offsets + i + 1, a->offsets + i, (a->ranges - i) * sizeof(int));
+        SDL_memmove(a->sizes + i + 1, a->sizes + i, (a->ranges - i) * sizeof(int));
+        a->offsets[i] = offset;
+        a->sizes[i] = size;
+        ++a->ranges;
+    }
+    a->used -= size;
+}
+
+static int largestRange(const Arena *a)
+{
+    int largest = 0;
+    for (int i = 0; i < a->ranges; ++i)
+        largest = SDL_max(largest, a->sizes[i]);
+    return largest;
+}
+
+void initMeshRegistry(MeshRegistry *r)
+{
+    SDL_memset(r, 0, sizeof(MeshRegistry));
+    initArena(&r->vertices, MESH_VERTEX_CAPACITY);
+    initArena(&r->indices, MESH_INDEX_CAPACITY);
+
+    glGenBuffers(1, &r->vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, r->vbo);
+    glBufferData(GL_ARRAY_BUFFER, MESH_VERTEX_CAPACITY * 3 * sizeof(GLfloat), NULL, GL_STATIC_DRAW);
+    glGenBuffers(1, &r->ibo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, r->ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, MESH_INDEX_CAPACITY * sizeof(GLuint), NULL, GL_STATIC_DRAW);
+}
+
+void freeMeshRegistry(MeshRegistry *r)
+{
+    glDeleteBuffers(1, &r->vbo);
+    glDeleteBuffers(1, &r->ibo);
+    r->vbo = 0;
+    r->ibo = 0;
+}
+
+int addMesh(MeshRegistry *r, const GLfloat *vertices, int vertexCount, const GLuint *indices, int indexCount)
+{
+    int handle, i;
+
+    if (vertexCount <= 0 || indexCount <= 0)
+    {
+        printf("Couldn't add a mesh of %d vertices and %d indices\n", vertexCount, indexCount);
+        return -1;
+    }
+
+    for (handle = 0; handle < MESH_MAX_MESHES; ++handle)
+        if (!r->meshes[handle].used)
+            break;
+    if (handle == MESH_MAX_MESHES)
+    {
+        printf("Couldn't add a mesh, all %d are in use\n", MESH_MAX_MESHES);
+        return -1;
+    }
+
+    int firstVertex = arenaAlloc(&r->vertices, vertexCount);
+    int firstIndex = firstVertex >= 0 ? arenaAlloc(&r->indices, indexCount) : -1;
+    if (firstIndex < 0)
+    {
+        if (firstVertex >= 0)
+            arenaFree(&r->vertices, firstVertex, vertexCount);
+        printf("Couldn't add a mesh of %d vertices and %d indices, the arenas are full\n", vertexCount, indexCount);
+        return -1;
+    }
+
+    Mesh *m = &r->meshes[handle];
+    m->used = 1;
+    m->firstVertex = firstVertex;
+    m->vertexCount = vertexCount;
+    m->firstIndex = firstIndex;
+    m->indexCount = indexCount;
+    m->min = vec3(vertices[0], vertices[1], vertices[2]);
+    m->max = m->min;
+    for (i = 1; i < vertexCount; ++i)
+    {
+        const GLfloat *v = vertices + i * 3;
+        m->min = vec3(SDL_min(m->min.x, v[0]), SDL_min(m->min.y, v[1]), SDL_min(m->min.z, v[2]));
+        m->max = vec3(SDL_max(m->max.x, v[0]), SDL_max(m->max.y, v[1]), SDL_max(m->max.z, v[2]));
+    }
+    m->center = v3_muls(v3_add(m->min, m->max), 0.5f);
+    m->radius = 0;
+    for (i = 0; i < vertexCount; ++i)
+        m->radius = SDL_max(m->radius, v3_length(v3_sub(vec3(vertices[i * 3], vertices[i * 3 + 1], vertices[i * 3 + 2]), m->center)));
+
+    glBindBuffer(GL_ARRAY_BUFFER, r->vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, firstVertex * 3 * sizeof(GLfloat), vertexCount * 3 * sizeof(GLfloat), vertices);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, r->ibo);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, firstIndex * sizeof(GLuint), indexCount * sizeof(GLuint), indices);
+    return handle;
+}
+
+void removeMesh(MeshRegistry *r, int handle)
+{
+    Mesh *m = &r->meshes[handle];
+    if (!m->used)
+        return;
+    arenaFree(&r->vertices, m->firstVertex, m->vertexCount);
+    arenaFree(&r->indices, m->firstIndex, m->indexCount);
+    m->used = 0;
+}
+
+const Mesh *registeredMesh(MeshRegistry *r, int handle)
+{
+    return &r->meshes[handle];
+}
+
+void bindMeshBuffers(MeshRegistry *r, GLuint location)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, r->vbo);
+    glEnableVertexAttribArray(location);
+    glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), NULL);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, r->ibo);
+}
+
+void drawMesh(const Mesh *m, InstanceBuffer *instances, int first, int count)
+{
+    drawInstances(instances, GL_LINES, m->indexCount, m->firstIndex, m->firstVertex, first, count);
+}
+
+void printMeshRegistry(MeshRegistry *r)
+{
+    printf("meshes:\n");
+    for (int i = 0; i < MESH_MAX_MESHES; ++i)
+    {
+        Mesh *m = &r->meshes[i];
+        if (m->used)
+            printf("  %3d: vertices %6d + %5d, indices %7d + %6d, bounds (%.2f %.2f %.2f) to (%.2f %.2f %.2f), radius %.2f\n", i,
+                m->firstVertex, m->vertexCount, m->firstIndex, m->indexCount,
+                m->min.x, m->min.y, m->min.z, m->max.x, m->max.y, m->max.z, m->radius);
+    }
+    printf("  vertex arena %d / %d used, %d free ranges, largest %d\n", r->vertices.used, r->vertices.capacity,
+        r->vertices.ranges, largestRange(&r->vertices));
+    printf("  index arena %d / %d used, %d free ranges, largest %d\n", r->indices.used, r->indices.capacity,
+        r->indices.ranges, largestRange(&r->indices));
+}
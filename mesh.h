@@ -0,0 +1,83 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <SDL.h>
+#include <gl\glew.h>
+
+#include "instance.h"
+#include "math_3d.h"
+
+// the shared arenas every mesh is packed into, in vertices and indices
+#define MESH_VERTEX_CAPACITY 65536
+#define MESH_INDEX_CAPACITY 262144
+#define MESH_MAX_MESHES 256
+
+// free ranges of an arena. there is never more than one more than there
+// are meshes in it
+#define ARENA_MAX_RANGES (MESH_MAX_MESHES + 1)
+
+// the free ranges of a buffer, sorted by offset, with neighbours joined.
+// allocations take the first range they fit in
+typedef struct
+{
+    int capacity;
+    int used;
+    int ranges;
+    int offsets[ARENA_MAX_RANGES];
+    int sizes[ARENA_MAX_RANGES];
+} Arena;
+
+// where a mesh is in the arenas and what it covers. its indices count
+// from its own first vertex, which its draws pass as the base vertex
+typedef struct
+{
+    int used; // 0 when the slot is free
+    int firstVertex;
+    int vertexCount;
+    int firstIndex;
+    int indexCount;
+    // bounds in model space. the sphere is around the middle of the box
+    vec3_t min;
+    vec3_t max;
+    vec3_t center;
+    float radius;
+} Mesh;
+
+// every mesh in one vertex buffer and one index buffer, so a single vao
+// draws them all and adding a mesh adds no binds. meshes are line lists
+// of 3 float positions and GLuint indices. game thread only
+typedef struct
+{
+    GLuint vbo;
+    GLuint ibo;
+    Arena vertices;
+    Arena indices;
+    Mesh meshes[MESH_MAX_MESHES];
+} MeshRegistry;
+
+// creates the arenas. they are left bound
+void initMeshRegistry(MeshRegistry *r);
+
+void freeMeshRegistry(MeshRegistry *r);
+
+// copies a mesh of vertexCount vertices into the arenas. returns its
+// handle, or -1 if it is empty or there is no room left for it
+int addMesh(MeshRegistry *r, const GLfloat *vertices, int vertexCount, const GLuint *indices, int indexCount);
+
+// gives the mesh's ranges back. nothing can draw it any more
+void removeMesh(MeshRegistry *r, int handle);
+
+const Mesh *registeredMesh(MeshRegistry *r, int handle);
+
+// points the position attribute at location of the bound vao at the
+// vertex arena, and binds the index arena to it
+void bindMeshBuffers(MeshRegistry *r, GLuint location);
+
+// draws count instances of a mesh with the vao bindMeshBuffers set up,
+// taking their matrices from instance first on
+void drawMesh(const Mesh *m, InstanceBuffer *instances, int first, int count);
+
+// each mesh and how full the arenas are
+void printMeshRegistry(MeshRegistry *r);
+
+#endif
@@ -0,0 +1,406 @@
+#include <math.h>
+
+#include "mix.h"
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define MIX_X86
+#include <immintrin.h>
+#endif
+
+MixF32Func mixF32 = mixF32Scalar;
+ConvertF32Func convertF32 = convertF32Scalar;
+MixS16Func mixS16 = mixS16Scalar;
+MixF32RampFunc mixF32Ramp = mixF32RampScalar;
+
+void mixF32Scalar(float *dst, const float *src, int count, float gain)
+{
+    int i;
+    for (i = 0; i < count; ++i)
+        dst[i] += src[i] * gain;
+}
+
+void mixF32RampScalar(float *dst, const float *src, int frames, int channels, const float *gain, const float *gainEnd)
+{
+    float g[MIX_MAX_CHANNELS], step[MIX_MAX_CHANNELS];
+    int i, c;
+    for (c = 0; c < channels; ++c)
+    {
+        g[c] = gain[c];
+        step[c] = frames > 0 ? (gainEnd[c] - gain[c]) / frames : 0;
+    }
+    for (i = 0; i < frames; ++i)
+        for (c = 0; c < channels; ++c)
+        {
+            *dst++ += *src++ * g[c];
+            g[c] += step[c];
+        }
+}
+
+static Uint32 xorshift(Uint32 x)
+{
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+// uniform 0 - 1 from the top 23 bits of x
+static float randomFloat(Uint32 x)
+{
+    union { Uint32 i; float f; } bits;
+    bits.i = x >> 9 | 0x3f800000;
+    return bits.f - 1.0f;
+}
+
+void convertF32Scalar(Sint16 *dst, const float *src, int count, Uint32 *dither)
+{
+    int i;
+    for (i = 0; i < count; ++i)
+    {
+        float x = src[i] * 32768.0f;
+        if (dither)
+        {
+            // the difference of two uniform values has a triangular distribution
+            Uint32 a = xorshift(dither[0]);
+            Uint32 b = xorshift(a);
+            dither[0] = b;
+            x += randomFloat(a) - randomFloat(b);
+        }
+        if (x >= SDL_MAX_SINT16)
+            dst[i] = SDL_MAX_SINT16;
+        else if (x <= SDL_MIN_SINT16)
+            dst[i] = SDL_MIN_SINT16;
+        else
+            // to nearest even like cvtps2dq, so every kernel gives the same
+            dst[i] = (Sint16)lrintf(x);
+    }
+}
+
+void mixS16Scalar(Sint16 *dst, const Sint16 *src, int count, int volume)
+{
+    int i;
+    for (i = 0; i < count; ++i)
+    {
+        int sample = dst[i] + (src[i] * volume) / SDL_MIX_MAXVOLUME;
+        if (sample > SDL_MAX_SINT16)
+            sample = SDL_MAX_SINT16;
+        else if (sample < SDL_MIN_SINT16)
+            sample = SDL_MIN_SINT16;
+        dst[i] = sample;
+    }
+}
+
+#ifdef MIX_X86
+
+__attribute__((target("sse2")))
+void mixF32SSE2(float *dst, const float *src, int count, float gain)
+{
+    __m128 g = _mm_set1_ps(gain);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_loadu_ps(src + i), g)));
+    mixF32Scalar(dst + i, src + i, count - i, gain);
+}
+
+__attribute__((target("avx2")))
+void mixF32AVX2(float *dst, const float *src, int count, float gain)
+{
+    __m256 g = _mm256_set1_ps(gain);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_mul_ps(_mm256_loadu_ps(src + i), g)));
+    _mm256_zeroupper();
+    mixF32Scalar(dst + i, src + i, count - i, gain);
+}
+
+// four samples at a time hold four mono frames or two stereo ones, so the
+// lanes start a frame apart and all step by the frames in a vector
+__attribute__((target("sse2")))
+void mixF32RampSSE2(float *dst, const float *src, int frames, int channels, const float *gain, const float *gainEnd)
+{
+    float step[MIX_MAX_CHANNELS];
+    float tail[MIX_MAX_CHANNELS];
+    __m128 g, s;
+    int count = frames * channels;
+    int i = 0, c;
+
+    if (channels != 1 && channels != 2)
+    {
+        mixF32RampScalar(dst, src, frames, channels, gain, gainEnd);
+        return;
+    }
+
+    for (c = 0; c < channels; ++c)
+        step[c] = frames > 0 ? (gainEnd[c] - gain[c]) / frames : 0;
+    if (channels == 1)
+    {
+        g = _mm_setr_ps(gain[0], gain[0] + step[0], gain[0] + 2 * step[0], gain[0] + 3 * step[0]);
+        s = _mm_set1_ps(4 * step[0]);
+    }
+    else
+    {
+        g = _mm_setr_ps(gain[0], gain[1], gain[0] + step[0], gain[1] + step[1]);
+        s = _mm_setr_ps(2 * step[0], 2 * step[1], 2 * step[0], 2 * step[1]);
+    }
+
+    for (; i + 4 <= count; i += 4, g = _mm_add_ps(g, s))
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_loadu_ps(src + i), g)));
+
+    // the leftover frames carry on from where the vector got to
+    for (c = 0; c < channels; ++c)
+        tail[c] = gain[c] + step[c] * (i / channels);
+    mixF32RampScalar(dst + i, src + i, frames - i / channels, channels, tail, gainEnd);
+}
+
+// each lane runs its own xorshift generator
+
+__attribute__((target("sse2")))
+static __m128i xorshiftSSE2(__m128i x)
+{
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+    return _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+}
+
+__attribute__((target("sse2")))
+static __m128 randomSSE2(__m128i x)
+{
+    __m128i bits = _mm_or_si128(_mm_srli_epi32(x, 9), _mm_set1_epi32(0x3f800000));
+    return _mm_sub_ps(_mm_castsi128_ps(bits), _mm_set1_ps(1.0f));
+}
+
+__attribute__((target("sse2")))
+void convertF32SSE2(Sint16 *dst, const float *src, int count, Uint32 *dither)
+{
+    __m128 scale = _mm_set1_ps(32768.0f);
+    __m128 hi = _mm_set1_ps(SDL_MAX_SINT16);
+    __m128 lo = _mm_set1_ps(SDL_MIN_SINT16);
+    __m128i state = dither ? _mm_loadu_si128((const __m128i*)dither) : _mm_setzero_si128();
+    int i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128 x0 = _mm_mul_ps(_mm_loadu_ps(src + i), scale);
+        __m128 x1 = _mm_mul_ps(_mm_loadu_ps(src + i + 4), scale);
+        if (dither)
+        {
+            __m128i a = xorshiftSSE2(state);
+            __m128i b = xorshiftSSE2(a);
+            __m128i c = xorshiftSSE2(b);
+            state = xorshiftSSE2(c);
+            x0 = _mm_add_ps(x0, _mm_sub_ps(randomSSE2(a), randomSSE2(b)));
+            x1 = _mm_add_ps(x1, _mm_sub_ps(randomSSE2(c), randomSSE2(state)));
+        }
+        // clamp in float, out of range floats don't convert to int sensibly
+        x0 = _mm_max_ps(_mm_min_ps(x0, hi), lo);
+        x1 = _mm_max_ps(_mm_min_ps(x1, hi), lo);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(_mm_cvtps_epi32(x0), _mm_cvtps_epi32(x1)));
+    }
+
+    if (dither)
+        _mm_storeu_si128((__m128i*)dither, state);
+    convertF32Scalar(dst + i, src + i, count - i, dither);
+}
+
+__attribute__((target("avx2")))
+static __m256i xorshiftAVX2(__m256i x)
+{
+    x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 13));
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 17));
+    return _mm256_xor_si256(x, _mm256_slli_epi32(x, 5));
+}
+
+__attribute__((target("avx2")))
+static __m256 randomAVX2(__m256i x)
+{
+    __m256i bits = _mm256_or_si256(_mm256_srli_epi32(x, 9), _mm256_set1_epi32(0x3f800000));
+    return _mm256_sub_ps(_mm256_castsi256_ps(bits), _mm256_set1_ps(1.0f));
+}
+
+__attribute__((target("avx2")))
+void convertF32AVX2(Sint16 *dst, const float *src, int count, Uint32 *dither)
+{
+    __m256 scale = _mm256_set1_ps(32768.0f);
+    __m256 hi = _mm256_set1_ps(SDL_MAX_SINT16);
+    __m256 lo = _mm256_set1_ps(SDL_MIN_SINT16);
+    __m256i state = dither ? _mm256_loadu_si256((const __m256i*)dither) : _mm256_setzero_si256();
+    int i = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256 x0 = _mm256_mul_ps(_mm256_loadu_ps(src + i), scale);
+        __m256 x1 = _mm256_mul_ps(_mm256_loadu_ps(src + i + 8), scale);
+        __m256i packed;
+        if (dither)
+        {
+            __m256i a = xorshiftAVX2(state);
+            __m256i b = xorshiftAVX2(a);
+            __m256i c = xorshiftAVX2(b);
+            state = xorshiftAVX2(c);
+            x0 = _mm256_add_ps(x0, _mm256_sub_ps(randomAVX2(a), randomAVX2(b)));
+            x1 = _mm256_add_ps(x1, _mm256_sub_ps(randomAVX2(c), randomAVX2(state)));
+        }
+        x0 = _mm256_max_ps(_mm256_min_ps(x0, hi), lo);
+        x1 = _mm256_max_ps(_mm256_min_ps(x1, hi), lo);
+        // packs works within 128 bit lanes, so put the quarters back in order
+        packed = _mm256_packs_epi32(_mm256_cvtps_epi32(x0), _mm256_cvtps_epi32(x1));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+
+    if (dither)
+        _mm256_storeu_si256((__m256i*)dither, state);
+    _mm256_zeroupper();
+    convertF32SSE2(dst + i, src + i, count - i, dither);
+}
+
+// SDL divides by SDL_MIX_MAXVOLUME (128), which rounds towards zero, so
+// negative products get 127 added before the arithmetic shift
+
+__attribute__((target("sse2")))
+static __m128i scaleSSE2(__m128i lo, __m128i hi, int low)
+{
+    __m128i p = low ? _mm_unpacklo_epi16(lo, hi) : _mm_unpackhi_epi16(lo, hi);
+    p = _mm_add_epi32(p, _mm_and_si128(_mm_srai_epi32(p, 31), _mm_set1_epi32(127)));
+    return _mm_srai_epi32(p, 7);
+}
+
+__attribute__((target("sse2")))
+void mixS16SSE2(Sint16 *dst, const Sint16 *src, int count, int volume)
+{
+    __m128i vol = _mm_set1_epi16(volume);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i lo = _mm_mullo_epi16(s, vol);
+        __m128i hi = _mm_mulhi_epi16(s, vol);
+
+        // sign extend dst to 32 bits and add the scaled source
+        __m128i d0 = _mm_srai_epi32(_mm_unpacklo_epi16(d, d), 16);
+        __m128i d1 = _mm_srai_epi32(_mm_unpackhi_epi16(d, d), 16);
+        d0 = _mm_add_epi32(d0, scaleSSE2(lo, hi, 1));
+        d1 = _mm_add_epi32(d1, scaleSSE2(lo, hi, 0));
+
+        // packs saturates back to 16 bits
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(d0, d1));
+    }
+    mixS16Scalar(dst + i, src + i, count - i, volume);
+}
+
+__attribute__((target("avx2")))
+static __m256i scaleAVX2(__m256i lo, __m256i hi, int low)
+{
+    __m256i p = low ? _mm256_unpacklo_epi16(lo, hi) : _mm256_unpackhi_epi16(lo, hi);
+    p = _mm256_add_epi32(p, _mm256_and_si256(_mm256_srai_epi32(p, 31), _mm256_set1_epi32(127)));
+    return _mm256_srai_epi32(p, 7);
+}
+
+__attribute__((target("avx2")))
+void mixS16AVX2(Sint16 *dst, const Sint16 *src, int count, int volume)
+{
+    __m256i vol = _mm256_set1_epi16(volume);
+    int i = 0;
+    // unpack and pack both work within 128 bit lanes so the order comes back out right
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+        __m256i lo = _mm256_mullo_epi16(s, vol);
+        __m256i hi = _mm256_mulhi_epi16(s, vol);
+
+        __m256i d0 = _mm256_srai_epi32(_mm256_unpacklo_epi16(d, d), 16);
+        __m256i d1 = _mm256_srai_epi32(_mm256_unpackhi_epi16(d, d), 16);
+        d0 = _mm256_add_epi32(d0, scaleAVX2(lo, hi, 1));
+        d1 = _mm256_add_epi32(d1, scaleAVX2(lo, hi, 0));
+
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_packs_epi32(d0, d1));
+    }
+    // avoid the avx to sse transition penalty in the tail
+    _mm256_zeroupper();
+    mixS16SSE2(dst + i, src + i, count - i, volume);
+}
+
+#else
+
+void mixF32SSE2(float *dst, const float *src, int count, float gain)
+{
+    mixF32Scalar(dst, src, count, gain);
+}
+
+void mixF32RampSSE2(float *dst, const float *src, int frames, int channels, const float *gain, const float *gainEnd)
+{
+    mixF32RampScalar(dst, src, frames, channels, gain, gainEnd);
+}
+
+void mixF32AVX2(float *dst, const float *src, int count, float gain)
+{
+    mixF32Scalar(dst, src, count, gain);
+}
+
+void convertF32SSE2(Sint16 *dst, const float *src, int count, Uint32 *dither)
+{
+    convertF32Scalar(dst, src, count, dither);
+}
+
+void convertF32AVX2(Sint16 *dst, const float *src, int count, Uint32 *dither)
+{
+    convertF32Scalar(dst, src, count, dither);
+}
+
+void mixS16SSE2(Sint16 *dst, const Sint16 *src, int count, int volume)
+{
+    mixS16Scalar(dst, src, count, volume);
+}
+
+void mixS16AVX2(Sint16 *dst, const Sint16 *src, int count, int volume)
+{
+    mixS16Scalar(dst, src, count, volume);
+}
+
+#endif
+
+void initDither(Uint32 *dither, Uint32 seed)
+{
+    int i;
+    for (i = 0; i < MIX_DITHER_LANES; ++i)
+    {
+        // xorshift gets stuck on zero
+        seed = seed * 1664525 + 1013904223;
+        dither[i] = seed ? seed : 1;
+    }
+}
+
+void initMix()
+{
+    mixF32 = mixF32Scalar;
+    convertF32 = convertF32Scalar;
+    mixS16 = mixS16Scalar;
+    mixF32Ramp = mixF32RampScalar;
+#ifdef MIX_X86
+    // ramps only get one 128 bit version, avx2 machines have sse2
+    if (SDL_HasSSE2())
+        mixF32Ramp = mixF32RampSSE2;
+    if (SDL_HasAVX2())
+    {
+        mixF32 = mixF32AVX2;
+        convertF32 = convertF32AVX2;
+        mixS16 = mixS16AVX2;
+    }
+    else if (SDL_HasSSE2())
+    {
+        mixF32 = mixF32SSE2;
+        convertF32 = convertF32SSE2;
+        mixS16 = mixS16SSE2;
+    }
+#endif
+}
+
+const char *mixKernelName()
+{
+    if (mixF32 == mixF32AVX2)
+        return "avx2";
+    if (mixF32 == mixF32SSE2)
+        return "sse2";
+    return "scalar";
+}
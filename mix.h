@@ -0,0 +1,63 @@
+#ifndef MIX_H
+#define MIX_H
+
+#include <SDL.h>
+
+// number of samples the mixer processes at a time
+#define MIX_BLOCK 256
+
+// lanes of random state the dithering kernels use
+#define MIX_DITHER_LANES 8
+
+// most channels a ramp can have its own gain for
+#define MIX_MAX_CHANNELS 8
+
+// adds count samples of src, scaled by gain, into the float mix bus dst
+typedef void (*MixF32Func)(float *dst, const float *src, int count, float gain);
+
+// converts count samples of the mix bus (-1 - 1) to 16 bit with saturation.
+// with a dither state it adds triangular dither of +-1 lsb first
+typedef void (*ConvertF32Func)(Sint16 *dst, const float *src, int count, Uint32 *dither);
+
+// mixes 16 bit samples straight into a 16 bit stream, scaled by volume
+// (0 - SDL_MIX_MAXVOLUME) and saturated after every voice. gives the same
+// result as SDL_MixAudioFormat with AUDIO_S16SYS. the mixer used to work
+// this way and bench keeps it to compare against
+typedef void (*MixS16Func)(Sint16 *dst, const Sint16 *src, int count, int volume);
+
+// like MixF32Func for frames of interleaved samples, with a gain for each
+// channel that moves from gain to gainEnd across the frames, so changes
+// don't step at block boundaries and voices can be panned
+typedef void (*MixF32RampFunc)(float *dst, const float *src, int frames, int channels, const float *gain, const float *gainEnd);
+
+// best kernels for this cpu, set by initMix()
+extern MixF32Func mixF32;
+extern ConvertF32Func convertF32;
+extern MixS16Func mixS16;
+extern MixF32RampFunc mixF32Ramp;
+
+void mixF32Scalar(float *dst, const float *src, int count, float gain);
+void mixF32SSE2(float *dst, const float *src, int count, float gain);
+void mixF32AVX2(float *dst, const float *src, int count, float gain);
+
+void convertF32Scalar(Sint16 *dst, const float *src, int count, Uint32 *dither);
+void convertF32SSE2(Sint16 *dst, const float *src, int count, Uint32 *dither);
+void convertF32AVX2(Sint16 *dst, const float *src, int count, Uint32 *dither);
+
+void mixS16Scalar(Sint16 *dst, const Sint16 *src, int count, int volume);
+void mixS16SSE2(Sint16 *dst, const Sint16 *src, int count, int volume);
+void mixS16AVX2(Sint16 *dst, const Sint16 *src, int count, int volume);
+
+void mixF32RampScalar(float *dst, const float *src, int frames, int channels, const float *gain, const float *gainEnd);
+void mixF32RampSSE2(float *dst, const float *src, int frames, int channels, const float *gain, const float *gainEnd);
+
+// seeds the dither state, MIX_DITHER_LANES values
+void initDither(Uint32 *dither, Uint32 seed);
+
+// picks the kernels for this cpu
+void initMix();
+
+// name of the kernel set in use
+const char *mixKernelName();
+
+#endif
@@ -0,0 +1,1251 @@
+#include "mixer.h"
+
+typedef union
+{
+    float f;
+    int i;
+} FloatBits;
+
+static int floatBits(float f)
+{
+    FloatBits bits;
+    bits.f = f;
+    return bits.i;
+}
+
+static float bitsFloat(int i)
+{
+    FloatBits bits;
+    bits.i = i;
+    return bits.f;
+}
+
+static void writeVector(SDL_atomic_t *dst, vec3_t v)
+{
+    SDL_AtomicSet(&dst[0], floatBits(v.x));
+    SDL_AtomicSet(&dst[1], floatBits(v.y));
+    SDL_AtomicSet(&dst[2], floatBits(v.z));
+}
+
+static vec3_t readVector(SDL_atomic_t *src)
+{
+    return vec3(bitsFloat(SDL_AtomicGet(&src[0])), bitsFloat(SDL_AtomicGet(&src[1])), bitsFloat(SDL_AtomicGet(&src[2])));
+}
+
+static void writeListener(Mixer *m, vec3_t position, vec3_t right, vec3_t velocity)
+{
+    ListenerParams *p = &m->listener;
+    SDL_AtomicAdd(&p->sequence, 1);
+    writeVector(p->position, position);
+    writeVector(p->right, right);
+    writeVector(p->velocity, velocity);
+    SDL_AtomicAdd(&p->sequence, 1);
+}
+
+void initMixer(Mixer *m, int freq, int channels)
+{
+    int i;
+    SDL_memset(m, 0, sizeof(Mixer));
+    m->freq = freq;
+    m->channels = channels;
+    m->quality = RESAMPLE_CUBIC;
+    m->dither = 1;
+    m->realVoices = MIXER_REAL_VOICES;
+    m->counterFreq = SDL_GetPerformanceFrequency();
+    initDither(m->ditherState, 1);
+    for (i = 0; i < MIXER_MAX_VOICES; ++i)
+    {
+        SDL_AtomicSet(&m->finished[i], -1);
+        SDL_AtomicSet(&m->emitters[i].voice, -1);
+        SDL_AtomicSet(&m->filters[i].voice, -1);
+    }
+    writeListener(m, vec3(0, 0, 0), vec3(1, 0, 0), vec3(0, 0, 0));
+}
+
+static int pushCommand(Mixer *m, const MixerCommand *command)
+{
+    int head = SDL_AtomicGet(&m->head);
+    if (head - SDL_AtomicGet(&m->tail) == MIXER_QUEUE_SIZE)
+        return 0;
+
+    m->queue[head & (MIXER_QUEUE_SIZE - 1)] = *command;
+    // publish the command before moving the head past it
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&m->head, head + 1);
+    return 1;
+}
+
+// game thread, the only writer
+static void writeParams(Mixer *m, int voice, float volume, float rate, float send)
+{
+    VoiceParams *p = &m->params[MIXER_VOICE_SLOT(voice)];
+    SDL_AtomicAdd(&p->sequence, 1);
+    SDL_AtomicSet(&p->voice, voice);
+    SDL_AtomicSet(&p->volume, floatBits(volume));
+    SDL_AtomicSet(&p->rate, floatBits(rate));
+    SDL_AtomicSet(&p->send, floatBits(send));
+    SDL_AtomicAdd(&p->sequence, 1);
+}
+
+// audio thread. gives up rather than spin if the game thread keeps writing
+static int readParams(Mixer *m, int slot, int *voice, float *volume, float *rate, float *send)
+{
+    VoiceParams *p = &m->params[slot];
+    int tries;
+    for (tries = 0; tries < 4; ++tries)
+    {
+        int sequence = SDL_AtomicGet(&p->sequence);
+        if (sequence & 1)
+            continue;
+        *voice = SDL_AtomicGet(&p->voice);
+        *volume = bitsFloat(SDL_AtomicGet(&p->volume));
+        *rate = bitsFloat(SDL_AtomicGet(&p->rate));
+        *send = bitsFloat(SDL_AtomicGet(&p->send));
+        if (SDL_AtomicGet(&p->sequence) == sequence)
+            return 1;
+    }
+    return 0;
+}
+
+// audio thread, like readParams
+static int readEmitter(Mixer *m, int slot, int *voice, vec3_t *position, vec3_t *velocity)
+{
+    EmitterParams *p = &m->emitters[slot];
+    int tries;
+    for (tries = 0; tries < 4; ++tries)
+    {
+        int sequence = SDL_AtomicGet(&p->sequence);
+        if (sequence & 1)
+            continue;
+        *voice = SDL_AtomicGet(&p->voice);
+        *position = readVector(p->position);
+        *velocity = readVector(p->velocity);
+        if (SDL_AtomicGet(&p->sequence) == sequence)
+            return 1;
+    }
+    return 0;
+}
+
+// audio thread, like readParams
+static int readFilter(Mixer *m, int slot, int *voice, BiquadSettings *settings)
+{
+    FilterParams *p = &m->filters[slot];
+    int tries, s;
+    for (tries = 0; tries < 4; ++tries)
+    {
+        int sequence = SDL_AtomicGet(&p->sequence);
+        if (sequence & 1)
+            continue;
+        *voice = SDL_AtomicGet(&p->voice);
+        for (s = 0; s < FILTER_STAGES; ++s)
+        {
+            settings[s].type = SDL_AtomicGet(&p->type[s]);
+            settings[s].cutoff = bitsFloat(SDL_AtomicGet(&p->cutoff[s]));
+            settings[s].q = bitsFloat(SDL_AtomicGet(&p->q[s]));
+            settings[s].gain = bitsFloat(SDL_AtomicGet(&p->gain[s]));
+        }
+        if (SDL_AtomicGet(&p->sequence) == sequence)
+            return 1;
+    }
+    return 0;
+}
+
+static int readListener(Mixer *m, vec3_t *position, vec3_t *right, vec3_t *velocity)
+{
+    ListenerParams *p = &m->listener;
+    int tries;
+    for (tries = 0; tries < 4; ++tries)
+    {
+        int sequence = SDL_AtomicGet(&p->sequence);
+        if (sequence & 1)
+            continue;
+        *position = readVector(p->position);
+        *right = readVector(p->right);
+        *velocity = readVector(p->velocity);
+        if (SDL_AtomicGet(&p->sequence) == sequence)
+            return 1;
+    }
+    return 0;
+}
+
+static int play(Mixer *m, const float *data, unsigned long frames, int channels, float volume, float rate, int loop, SampleStream *stream, const AdpcmSample *adpcm, Uint64 time)
+{
+    MixerCommand command;
+    int slot;
+
+    if (channels != 1 && channels != m->channels)
+        return -1;
+    if (frames == 0)
+        return -1;
+
+    for (slot = 0; slot < MIXER_MAX_VOICES; ++slot)
+    {
+        int voice = m->generation[slot] << MIXER_VOICE_BITS | slot;
+        if (!m->allocated[slot] || SDL_AtomicGet(&m->finished[slot]) == voice)
+            break;
+    }
+    if (slot == MIXER_MAX_VOICES)
+        return -1;
+
+    command.type = MIXER_PLAY;
+    command.voice = ((m->generation[slot] + 1) & MIXER_GENERATION_MASK) << MIXER_VOICE_BITS | slot;
+    command.data = data;
+    command.frames = frames;
+    command.channels = channels;
+    command.loop = loop;
+    command.volume = volume;
+    command.rate = rate;
+    command.stream = stream;
+    command.adpcm = adpcm;
+    command.time = time;
+    if (!pushCommand(m, &command))
+        return -1;
+
+    m->generation[slot] = MIXER_VOICE_GENERATION(command.voice);
+    m->allocated[slot] = 1;
+    writeParams(m, command.voice, volume, rate, 0);
+    return command.voice;
+}
+
+int mixerPlay(Mixer *m, const Sample *sample, float volume, float rate, int loop)
+{
+    return play(m, sample->data, sample->frames, sample->channels, volume, rate, loop, NULL, NULL, 0);
+}
+
+int mixerPlayAt(Mixer *m, const Sample *sample, float volume, float rate, int loop, Uint64 time)
+{
+    return play(m, sample->data, sample->frames, sample->channels, volume, rate, loop, NULL, NULL, time);
+}
+
+int mixerPlayStream(Mixer *m, SampleStream *stream, float volume, float rate)
+{
+    return play(m, stream->ring, stream->ringFrames, stream->channels, volume, rate, 1, stream, NULL, 0);
+}
+
+int mixerPlayAdpcm(Mixer *m, const AdpcmSample *sample, float volume, float rate, int loop)
+{
+    return play(m, NULL, sample->frames, sample->channels, volume, rate, loop, NULL, sample, 0);
+}
+
+int mixerVoiceDone(Mixer *m, int voice)
+{
+    int ended = SDL_AtomicGet(&m->finished[MIXER_VOICE_SLOT(voice)]);
+    // the slot's generations only move forward, so the voice is over if
+    // the last one to end is it or a later one, counting across the wrap
+    int since = (MIXER_VOICE_GENERATION(ended) - MIXER_VOICE_GENERATION(voice)) & MIXER_GENERATION_MASK;
+    return ended >= 0 && voice >= 0 && since <= MIXER_GENERATION_MASK / 2;
+}
+
+void mixerStop(Mixer *m, int voice)
+{
+    mixerStopAt(m, voice, 0);
+}
+
+void mixerStopAt(Mixer *m, int voice, Uint64 time)
+{
+    MixerCommand command;
+    int slot = MIXER_VOICE_SLOT(voice);
+    if (voice < 0 || m->generation[slot] != MIXER_VOICE_GENERATION(voice))
+        return;
+
+    command.type = MIXER_STOP;
+    command.voice = voice;
+    command.time = time;
+    // anything queued after this can safely reuse the slot
+    if (pushCommand(m, &command))
+        m->allocated[slot] = 0;
+}
+
+void mixerSetVolume(Mixer *m, int voice, float volume)
+{
+    VoiceParams *p = &m->params[MIXER_VOICE_SLOT(voice)];
+    if (voice < 0 || SDL_AtomicGet(&p->voice) != voice)
+        return;
+    writeParams(m, voice, volume, bitsFloat(SDL_AtomicGet(&p->rate)), bitsFloat(SDL_AtomicGet(&p->send)));
+}
+
+void mixerSetRate(Mixer *m, int voice, float rate)
+{
+    VoiceParams *p = &m->params[MIXER_VOICE_SLOT(voice)];
+    if (voice < 0 || SDL_AtomicGet(&p->voice) != voice)
+        return;
+    writeParams(m, voice, bitsFloat(SDL_AtomicGet(&p->volume)), rate, bitsFloat(SDL_AtomicGet(&p->send)));
+}
+
+void mixerSetSend(Mixer *m, int voice, float send)
+{
+    VoiceParams *p = &m->params[MIXER_VOICE_SLOT(voice)];
+    if (voice < 0 || SDL_AtomicGet(&p->voice) != voice)
+        return;
+    writeParams(m, voice, bitsFloat(SDL_AtomicGet(&p->volume)), bitsFloat(SDL_AtomicGet(&p->rate)), send);
+}
+
+void mixerSetEmitter(Mixer *m, int voice, vec3_t position, vec3_t velocity)
+{
+    EmitterParams *p = &m->emitters[MIXER_VOICE_SLOT(voice)];
+    if (voice < 0 || SDL_AtomicGet(&m->params[MIXER_VOICE_SLOT(voice)].voice) != voice)
+        return;
+    SDL_AtomicAdd(&p->sequence, 1);
+    SDL_AtomicSet(&p->voice, voice);
+    writeVector(p->position, position);
+    writeVector(p->velocity, velocity);
+    SDL_AtomicAdd(&p->sequence, 1);
+}
+
+void mixerSetFilter(Mixer *m, int voice, int stage, const BiquadSettings *settings)
+{
+    FilterParams *p = &m->filters[MIXER_VOICE_SLOT(voice)];
+    int s;
+    if (voice < 0 || stage < 0 || stage >= FILTER_STAGES || SDL_AtomicGet(&m->params[MIXER_VOICE_SLOT(voice)].voice) != voice)
+        return;
+    SDL_AtomicAdd(&p->sequence, 1);
+    // the stages the slot's last voice set don't carry over
+    if (SDL_AtomicGet(&p->voice) != voice)
+        for (s = 0; s < FILTER_STAGES; ++s)
+            SDL_AtomicSet(&p->type[s], FILTER_NONE);
+    SDL_AtomicSet(&p->voice, voice);
+    SDL_AtomicSet(&p->type[stage], settings->type);
+    SDL_AtomicSet(&p->cutoff[stage], floatBits(settings->cutoff));
+    SDL_AtomicSet(&p->q[stage], floatBits(settings->q));
+    SDL_AtomicSet(&p->gain[stage], floatBits(settings->gain));
+    SDL_AtomicAdd(&p->sequence, 1);
+}
+
+void mixerSetOcclusion(Mixer *m, int voice, float occlusion)
+{
+    BiquadSettings settings;
+    occlusion = SDL_min(SDL_max(occlusion, 0.0f), 1.0f);
+    settings.type = occlusion > 0 ? FILTER_LOW_PASS : FILTER_NONE;
+    settings.cutoff = MIXER_OPEN_CUTOFF * powf(MIXER_OCCLUDED_CUTOFF / MIXER_OPEN_CUTOFF, occlusion);
+    settings.q = 0.7071f;
+    settings.gain = 0;
+    mixerSetFilter(m, voice, FILTER_STAGES - 1, &settings);
+}
+
+void mixerSetListener(Mixer *m, mat4_t view, vec3_t velocity)
+{
+    // the rows of the rotation are the camera's axes in the world, and
+    // the camera sits at minus the translation rotated back
+    vec3_t right = vec3(view.m00, view.m10, view.m20);
+    vec3_t up = vec3(view.m01, view.m11, view.m21);
+    vec3_t back = vec3(view.m02, view.m12, view.m22);
+    vec3_t position = v3_add(v3_add(v3_muls(right, -view.m30), v3_muls(up, -view.m31)), v3_muls(back, -view.m32));
+    writeListener(m, position, right, velocity);
+}
+
+void mixerSetQuality(Mixer *m, int quality)
+{
+    MixerCommand command;
+    command.type = MIXER_SET_QUALITY;
+    command.time = 0;
+    command.voice = -1;
+    command.value = quality;
+    pushCommand(m, &command);
+}
+
+void mixerSetDither(Mixer *m, int dither)
+{
+    MixerCommand command;
+    command.type = MIXER_SET_DITHER;
+    command.time = 0;
+    command.voice = -1;
+    command.value = dither;
+    pushCommand(m, &command);
+}
+
+void mixerSetReverb(Mixer *m, Reverb *reverb)
+{
+    MixerCommand command;
+    command.type = MIXER_SET_REVERB;
+    command.time = 0;
+    command.voice = -1;
+    command.reverb = reverb;
+    pushCommand(m, &command);
+}
+
+void mixerSetPriority(Mixer *m, int voice, int priority)
+{
+    MixerCommand command;
+    if (voice < 0)
+        return;
+    command.type = MIXER_SET_PRIORITY;
+    command.time = 0;
+    command.voice = voice;
+    command.value = priority;
+    pushCommand(m, &command);
+}
+
+void mixerSetRealVoices(Mixer *m, int count)
+{
+    MixerCommand command;
+    command.type = MIXER_SET_REAL_VOICES;
+    command.time = 0;
+    command.voice = -1;
+    command.value = SDL_min(SDL_max(count, 0), MIXER_MAX_VOICES);
+    pushCommand(m, &command);
+}
+
+void mixerSetClock(Mixer *m, Uint64 time, Uint32 frame, int delay)
+{
+    m->clockTime = time;
+    m->clockFrame = frame;
+    m->scheduleDelay = delay;
+}
+
+// the frame in the buffer about to be rendered that a command's time maps
+// to. untimed commands and late ones go at the start
+static Sint64 commandFrame(Mixer *m, const MixerCommand *command)
+{
+    Sint64 ticks, frame;
+    if (command->time == 0 || m->clockTime == 0)
+        return 0;
+
+    ticks = (Sint64)(command->time - m->clockTime);
+    frame = (Sint32)(m->clockFrame - m->frame) + ticks * m->freq / (Sint64)m->counterFreq + m->scheduleDelay;
+    if (frame < 0)
+    {
+        SDL_AtomicAdd(&m->lateCommands, 1);
+        return 0;
+    }
+    return frame;
+}
+
+static int claimDecoder(Mixer *m)
+{
+    int i;
+    for (i = 0; i < MIXER_DECODERS; ++i)
+        if (!m->decoders[i].used)
+        {
+            m->decoders[i].used = 1;
+            return i;
+        }
+    return -1;
+}
+
+// takes a voice out of the mix, handing back its decoder
+static void endVoice(Mixer *m, Voice *v)
+{
+    v->active = 0;
+    SDL_AtomicSet(&m->finished[MIXER_VOICE_SLOT(v->voice)], v->voice);
+    if (v->adpcm && v->decoder >= 0)
+        m->decoders[v->decoder].used = 0;
+    v->adpcm = NULL;
+}
+
+// sets a compressed voice up to play its decoder's ring, or finishes it
+// straight away if there is no decoder free
+static void startDecoder(Mixer *m, Voice *v, const AdpcmSample *a, int loop)
+{
+    AdpcmDecoder *d;
+    v->decoder = claimDecoder(m);
+    v->rateScale = (float)a->freq / m->freq;
+    if (v->decoder < 0)
+    {
+        initResampler(&v->source, NULL, 0, a->channels, 0);
+        v->source.finished = 1;
+        return;
+    }
+
+    d = &m->decoders[v->decoder];
+    SDL_memset(d->ring, 0, sizeof(d->ring));
+    d->loop = loop;
+    d->decoded = 0;
+    d->sampleFrame = 0;
+    d->ended = 0;
+    initResampler(&v->source, d->ring, MIXER_DECODE_FRAMES, a->channels, 1);
+}
+
+// offset is where in this buffer a timed command lands
+static void runCommand(Mixer *m, const MixerCommand *command, int offset)
+{
+    Voice *v = &m->voices[MIXER_VOICE_SLOT(command->voice)];
+    int i;
+
+    switch (command->type)
+    {
+        case MIXER_PLAY:
+            // a voice stopped later in the last buffer can still hold a decoder
+            if (v->active)
+                endVoice(m, v);
+            v->active = 1;
+            v->voice = command->voice;
+            v->volume = command->volume;
+            v->rate = command->rate;
+            v->send = 0;
+            for (i = 0; i < MIX_MAX_CHANNELS; ++i)
+                v->pan[i] = 1.0f;
+            v->doppler = 1.0f;
+            // FILTER_NONE
+            SDL_memset(v->filter, 0, sizeof(v->filter));
+            SDL_memset(v->filterZ1, 0, sizeof(v->filterZ1));
+            SDL_memset(v->filterZ2, 0, sizeof(v->filterZ2));
+            v->priority = 0;
+            v->mixed = 0;
+            v->fresh = 1;
+            v->startFrame = offset;
+            v->stopFrame = -1;
+            v->stream = command->stream;
+            v->streamPos = 0;
+            v->rateScale = command->stream ? (float)command->stream->freq / m->freq : 1.0f;
+            v->adpcm = command->adpcm;
+            if (v->adpcm)
+                startDecoder(m, v, v->adpcm, command->loop);
+            else
+                initResampler(&v->source, command->data, command->frames, command->channels, command->loop);
+            break;
+        case MIXER_STOP:
+            if (v->voice != command->voice)
+                break;
+            if (offset > v->startFrame)
+                v->stopFrame = offset;
+            else
+                endVoice(m, v);
+            break;
+        case MIXER_SET_QUALITY:
+            m->quality = command->value;
+            break;
+        case MIXER_SET_DITHER:
+            m->dither = command->value;
+            break;
+        case MIXER_SET_PRIORITY:
+            if (v->voice == command->voice)
+                v->priority = command->value;
+            break;
+        case MIXER_SET_REAL_VOICES:
+            m->realVoices = command->value;
+            break;
+        case MIXER_SET_REVERB:
+            // the new room starts empty rather than with whatever was
+            // left in it the last time it was used
+            m->reverb = command->reverb;
+            if (m->reverb)
+                resetReverb(m->reverb);
+            break;
+    }
+}
+
+// checks a streamed voice has enough frames in the ring for the next n
+// frames at up to rate. a stream that doesn't loop finishes when it can't
+static int streamReady(Voice *v, int n, float rate)
+{
+    SampleStream *s = v->stream;
+    int needed = (int)(n * rate) + SINC_TAPS;
+    // read the count before the frames it covers
+    int available = SDL_AtomicGet(&s->written) - (int)v->streamPos;
+    SDL_MemoryBarrierAcquire();
+
+    if (available >= needed)
+        return 1;
+    if (SDL_AtomicGet(&s->eof))
+        v->source.finished = 1;
+    else
+        SDL_AtomicAdd(&s->underruns, 1);
+    return 0;
+}
+
+// hands the ring frames the voice has finished with back to the reader,
+// keeping enough behind the position for the resampler's filter
+static void streamAdvance(Voice *v, Uint32 lastPos)
+{
+    SampleStream *s = v->stream;
+    v->streamPos += (v->source.pos - lastPos) & (s->ringFrames - 1);
+    SDL_AtomicSet(&s->released, (int)v->streamPos - SINC_TAPS);
+}
+
+// runs the commands that land in the next frames frames. the first one
+// that lands later holds up the rest until a later buffer
+static void runCommands(Mixer *m, int frames)
+{
+    int tail = SDL_AtomicGet(&m->tail);
+    int head = SDL_AtomicGet(&m->head);
+    // don't read the commands before the head that covers them
+    SDL_MemoryBarrierAcquire();
+
+    while (tail != head)
+    {
+        const MixerCommand *command = &m->queue[tail & (MIXER_QUEUE_SIZE - 1)];
+        Sint64 frame = commandFrame(m, command);
+        if (frame >= frames)
+            break;
+        runCommand(m, command, (int)frame);
+        ++tail;
+    }
+    SDL_AtomicSet(&m->tail, tail);
+}
+
+// the part of frames [done, done + n) of the buffer a voice plays in,
+// after it starts and before it stops. 0 if there is none
+static int voiceRange(const Voice *v, int done, int n, int *start, int *end)
+{
+    *start = SDL_max(done, v->startFrame);
+    *end = v->stopFrame >= 0 ? SDL_min(done + n, v->stopFrame) : done + n;
+    return *start < *end;
+}
+
+// the rates a voice steps through its source at over frames
+// [done, done + n) of the buffer
+static void blockRates(const Voice *v, int done, int n, int frames, float *rateStart, float *rateEnd)
+{
+    float rate = v->rate * v->doppler;
+    float targetRate = v->targetRate * v->targetDoppler;
+    *rateStart = (rate + (targetRate - rate) * done / frames) * v->rateScale;
+    *rateEnd = (rate + (targetRate - rate) * (done + n) / frames) * v->rateScale;
+}
+
+// checks a compressed voice has been decoded far enough for the next n
+// frames at up to rate. past the end of a sample that doesn't loop the
+// ring is silent, and the voice finishes once it gets there
+static int decoderReady(Mixer *m, Voice *v, int n, float rate)
+{
+    AdpcmDecoder *d = &m->decoders[v->decoder];
+    int needed = (int)(n * rate) + SINC_TAPS;
+    if (d->ended)
+    {
+        if ((Sint32)(v->streamPos - d->end) < 0)
+            return 1;
+        v->source.finished = 1;
+        return 0;
+    }
+    return (Sint32)(d->decoded - v->streamPos) >= needed;
+}
+
+// starts decoding again at the block a voice has skipped to. the frames
+// just behind it are left as they were, since it fades back in anyway
+static void restartDecoder(AdpcmDecoder *d, Voice *v)
+{
+    const AdpcmSample *a = v->adpcm;
+    unsigned long frame;
+    if (!d->loop && v->streamPos >= a->frames)
+    {
+        d->ended = 1;
+        d->decoded = d->end = v->streamPos;
+        return;
+    }
+    frame = v->streamPos % a->frames;
+    d->sampleFrame = frame - frame % ADPCM_BLOCK_FRAMES;
+    d->decoded = v->streamPos - frame % ADPCM_BLOCK_FRAMES;
+}
+
+// a channel of a block waiting for the decoder, and where it goes
+typedef struct
+{
+    AdpcmDecoder *decoder;
+    Uint32 at;
+    int channels;
+    int channel;
+} DecodeJob;
+
+// decodes up to ADPCM_LANES queued channel blocks at once and copies each
+// into its ring. they go in queue order, so a block overwrites the padding
+// at the end of a sample before it
+static void flushDecodes(const Uint8 **blocks, const DecodeJob *jobs, int count)
+{
+    float lanes[ADPCM_BLOCK_FRAMES * ADPCM_LANES];
+    int j, i;
+    decodeAdpcm(blocks, count, lanes);
+    for (j = 0; j < count; ++j)
+    {
+        const DecodeJob *job = &jobs[j];
+        float *ring = job->decoder->ring + job->channel;
+        for (i = 0; i < ADPCM_BLOCK_FRAMES; ++i)
+            ring[((job->at + i) & (MIXER_DECODE_FRAMES - 1)) * job->channels] = lanes[i * ADPCM_LANES + j];
+    }
+}
+
+// a batch of channel blocks waiting for the decoder
+typedef struct
+{
+    const Uint8 *blocks[ADPCM_LANES];
+    DecodeJob jobs[ADPCM_LANES];
+    int count;
+} DecodeBatch;
+
+// whether the next block of a voice fits in its ring without touching what
+// the resampler still reads behind the position
+static int decoderRoom(const Voice *v, const AdpcmDecoder *d)
+{
+    return !d->ended && (Sint32)(d->decoded - v->streamPos) + ADPCM_BLOCK_FRAMES <= MIXER_DECODE_FRAMES - SINC_TAPS;
+}
+
+// queues every channel of a voice's next block, decoding the batch
+// whenever it fills up
+static void queueBlock(DecodeBatch *batch, Voice *v, AdpcmDecoder *d)
+{
+    const AdpcmSample *a = v->adpcm;
+    int block = (int)(d->sampleFrame / ADPCM_BLOCK_FRAMES);
+    int valid = (int)SDL_min(ADPCM_BLOCK_FRAMES, a->frames - d->sampleFrame);
+    int c;
+
+    for (c = 0; c < a->channels; ++c)
+    {
+        DecodeJob *job;
+        if (batch->count == ADPCM_LANES)
+        {
+            flushDecodes(batch->blocks, batch->jobs, batch->count);
+            batch->count = 0;
+        }
+        job = &batch->jobs[batch->count];
+        batch->blocks[batch->count++] = adpcmBlock(a, block, c);
+        job->decoder = d;
+        job->at = d->decoded;
+        job->channels = a->channels;
+        job->channel = c;
+    }
+
+    d->decoded += valid;
+    d->sampleFrame += valid;
+    if (d->sampleFrame < a->frames)
+        return;
+    if (d->loop)
+        d->sampleFrame = 0;
+    else
+    {
+        d->ended = 1;
+        d->end = d->decoded;
+    }
+}
+
+// decodes far enough ahead of every compressed voice being mixed for
+// frames [done, done + n) of the buffer. usually that is a block or none,
+// and the blocks of all the voices are decoded side by side
+static void topUpDecoders(Mixer *m, int mixing, int done, int n, int frames)
+{
+    DecodeBatch batch;
+    int i, spare;
+    batch.count = 0;
+
+    for (i = 0; i < mixing; ++i)
+    {
+        Voice *v = &m->voices[m->playing[i]];
+        AdpcmDecoder *d;
+        float rateStart, rateEnd;
+        int start, end, needed;
+        if (!v->adpcm || v->source.finished || !voiceRange(v, done, n, &start, &end))
+            continue;
+        d = &m->decoders[v->decoder];
+        if (!d->ended && (Sint32)(d->decoded - v->streamPos) < 0)
+            restartDecoder(d, v);
+
+        blockRates(v, start, end - start, frames, &rateStart, &rateEnd);
+        needed = (int)((end - start) * SDL_max(rateStart, rateEnd)) + SINC_TAPS;
+        while ((Sint32)(d->decoded - v->streamPos) < needed && decoderRoom(v, d))
+            queueBlock(&batch, v, d);
+    }
+
+    // lanes left over in the last batch cost the same whether they are
+    // used or not, so they decode further ahead for whoever has room
+    do
+    {
+        spare = 0;
+        for (i = 0; i < mixing && batch.count > 0; ++i)
+        {
+            Voice *v = &m->voices[m->playing[i]];
+            AdpcmDecoder *d;
+            if (!v->adpcm || v->source.finished || batch.count + v->adpcm->channels > ADPCM_LANES)
+                continue;
+            d = &m->decoders[v->decoder];
+            if ((Sint32)(d->decoded - v->streamPos) < 0 || !decoderRoom(v, d))
+                continue;
+            queueBlock(&batch, v, d);
+            spare = 1;
+        }
+    } while (spare);
+    if (batch.count)
+        flushDecodes(batch.blocks, batch.jobs, batch.count);
+
+    // silence after the end, once the last block's padding is in
+    for (i = 0; i < mixing; ++i)
+    {
+        Voice *v = &m->voices[m->playing[i]];
+        AdpcmDecoder *d;
+        Uint32 f, last;
+        if (!v->adpcm || v->decoder < 0 || m->decoders[v->decoder].ended != 1)
+            continue;
+        d = &m->decoders[v->decoder];
+        last = v->streamPos + MIXER_DECODE_FRAMES - SINC_TAPS;
+        for (f = d->end; f != last; ++f)
+            SDL_memset(d->ring + (f & (MIXER_DECODE_FRAMES - 1)) * v->adpcm->channels, 0,
+                v->adpcm->channels * sizeof(float));
+        d->ended = 2;
+    }
+}
+
+// resamples frames [done, done + n) of the buffer for one voice into
+// block, in the source's channels. 0 if a stream has nothing for it yet
+static int sourceVoice(Mixer *m, Voice *v, float *block, int done, int n, int frames)
+{
+    float rateStart, rateEnd;
+    blockRates(v, done, n, frames, &rateStart, &rateEnd);
+
+    if (v->stream)
+    {
+        Uint32 lastPos = v->source.pos;
+        if (!streamReady(v, n, SDL_max(rateStart, rateEnd)))
+            return 0;
+        resample(block, n, &v->source, rateStart, rateEnd, m->quality);
+        streamAdvance(v, lastPos);
+    }
+    else if (v->adpcm)
+    {
+        Uint32 lastPos = v->source.pos;
+        if (!decoderReady(m, v, n, SDL_max(rateStart, rateEnd)))
+            return 0;
+        resample(block, n, &v->source, rateStart, rateEnd, m->quality);
+        v->streamPos += (v->source.pos - lastPos) & (MIXER_DECODE_FRAMES - 1);
+    }
+    else
+        resample(block, n, &v->source, rateStart, rateEnd, m->quality);
+    return 1;
+}
+
+// mixes n frames of a voice's source block into bus, ramping from the
+// voice's last values to its targets over the buffer
+static void mixVoice(Mixer *m, Voice *v, const float *block, float *bus, float *send, int done, int n, int frames)
+{
+    float expanded[MIX_BLOCK];
+    float gain[MIX_MAX_CHANNELS];
+    float gainEnd[MIX_MAX_CHANNELS];
+    int channels = m->channels;
+    const float *src = block;
+    float fade = 1, fadeEnd = 1;
+    int ramp = 0;
+    int c;
+
+    // fade out over the buffer going virtual and in coming back, so the
+    // voice doesn't click
+    if (!v->audible)
+    {
+        fade = 1 - (float)done / frames;
+        fadeEnd = 1 - (float)(done + n) / frames;
+    }
+    else if (!v->mixed && !v->fresh)
+    {
+        fade = (float)done / frames;
+        fadeEnd = (float)(done + n) / frames;
+    }
+
+    for (c = 0; c < channels; ++c)
+    {
+        float g = v->volume * v->pan[c];
+        float target = v->targetVolume * v->targetPan[c];
+        gain[c] = (g + (target - g) * done / frames) * fade;
+        gainEnd[c] = (g + (target - g) * (done + n) / frames) * fadeEnd;
+        ramp |= gain[c] != gainEnd[c] || gain[c] != gain[0];
+    }
+
+    // mono voices play in every channel
+    if (v->source.channels != channels)
+    {
+        int f;
+        for (f = 0; f < n; ++f)
+            for (c = 0; c < channels; ++c)
+                expanded[f * channels + c] = block[f];
+        src = expanded;
+    }
+
+    if (ramp)
+        mixF32Ramp(bus, src, n, channels, gain, gainEnd);
+    else
+        mixF32(bus, src, n * channels, gain[0]);
+
+    // the send is taken after volume and position, so distant voices
+    // are quieter in the reverb too
+    if (m->reverb && (v->send > 0 || v->targetSend > 0))
+    {
+        float sendStart = v->send + (v->targetSend - v->send) * done / frames;
+        float sendEnd = v->send + (v->targetSend - v->send) * (done + n) / frames;
+        for (c = 0; c < channels; ++c)
+        {
+            gain[c] *= sendStart;
+            gainEnd[c] *= sendEnd;
+        }
+        mixF32Ramp(send, src, n, channels, gain, gainEnd);
+    }
+}
+
+static void renderVoice(Mixer *m, Voice *v, float *bus, float *send, int done, int n, int frames)
+{
+    float block[MIX_BLOCK];
+    int skip = 0, start, end;
+    if (!voiceRange(v, done, n, &start, &end))
+        return;
+    skip = (start - done) * m->channels;
+    if (sourceVoice(m, v, block, start, end - start, frames))
+        mixVoice(m, v, block, bus + skip, send + skip, start, end - start, frames);
+}
+
+// how many stages have to run for a voice this buffer, 0 if it isn't
+// filtered at all
+static int filterStages(const Voice *v)
+{
+    int s;
+    for (s = FILTER_STAGES; s > 0; --s)
+        if (v->filter[s - 1].type != FILTER_NONE || v->targetFilter[s - 1].type != FILTER_NONE)
+            return s;
+    return 0;
+}
+
+// a stage's coefficients for the middle of the block. the same type glides
+// from the last settings to the new, a new type starts straight away
+static void blockBiquad(Mixer *m, Voice *v, int stage, int done, int n, int frames, Biquad *b)
+{
+    const BiquadSettings *from = &v->filter[stage];
+    BiquadSettings settings = v->targetFilter[stage];
+    float t = (done + n * 0.5f) / frames;
+
+    if (from->type == settings.type)
+    {
+        if (from->cutoff > 0 && settings.cutoff > 0)
+            settings.cutoff = from->cutoff * powf(settings.cutoff / from->cutoff, t);
+        settings.q = from->q + (settings.q - from->q) * t;
+        settings.gain = from->gain + (settings.gain - from->gain) * t;
+    }
+    makeBiquad(b, &settings, m->freq);
+}
+
+// state this small would only decay into denormals, which are slow
+static float flushState(float z)
+{
+    return fabsf(z) < 1e-15f ? 0 : z;
+}
+
+// renders a group of filtered voices, with every source channel in its own
+// lane of the filter bank so they are all filtered at once. the group
+// has at most FILTER_LANES channels
+static void renderFiltered(Mixer *m, Voice **group, int count, int stages, float *bus, float *send, int done, int n, int frames)
+{
+    float blocks[FILTER_LANES][MIX_BLOCK];
+    float lanes[MIX_BLOCK * FILTER_LANES];
+    int ready[FILTER_LANES];
+    int start[FILTER_LANES], end[FILTER_LANES];
+    FilterBank bank;
+    int g, s, c, f, l;
+    int lane = 0;
+
+    // lanes nobody uses pass silence through unchanged
+    SDL_memset(&bank, 0, sizeof(bank));
+    SDL_memset(lanes, 0, n * FILTER_LANES * sizeof(float));
+    for (s = 0; s < stages; ++s)
+        for (l = 0; l < FILTER_LANES; ++l)
+            bank.b0[s][l] = 1;
+
+    for (g = 0; g < count; ++g)
+    {
+        Voice *v = group[g];
+        int channels = v->source.channels;
+
+        // the lanes are silent around the part the voice plays in
+        ready[g] = voiceRange(v, done, n, &start[g], &end[g]) &&
+            sourceVoice(m, v, blocks[g], start[g], end[g] - start[g], frames);
+        for (s = 0; s < stages; ++s)
+        {
+            Biquad b;
+            blockBiquad(m, v, s, done, n, frames, &b);
+            for (c = 0; c < channels; ++c)
+            {
+                setBankLane(&bank, s, lane + c, &b);
+                bank.z1[s][lane + c] = v->filterZ1[s][c];
+                bank.z2[s][lane + c] = v->filterZ2[s][c];
+            }
+        }
+        if (ready[g])
+            for (f = start[g]; f < end[g]; ++f)
+                for (c = 0; c < channels; ++c)
+                    lanes[(f - done) * FILTER_LANES + lane + c] = blocks[g][(f - start[g]) * channels + c];
+        lane += channels;
+    }
+
+    filterBank(lanes, n, &bank, stages);
+
+    lane = 0;
+    for (g = 0; g < count; ++g)
+    {
+        Voice *v = group[g];
+        int channels = v->source.channels;
+
+        // a starved stream keeps its state for when it comes back
+        if (ready[g])
+        {
+            int skip = (start[g] - done) * m->channels;
+            for (f = start[g]; f < end[g]; ++f)
+                for (c = 0; c < channels; ++c)
+                    blocks[g][(f - start[g]) * channels + c] = lanes[(f - done) * FILTER_LANES + lane + c];
+            for (s = 0; s < stages; ++s)
+                for (c = 0; c < channels; ++c)
+                {
+                    v->filterZ1[s][c] = flushState(bank.z1[s][lane + c]);
+                    v->filterZ2[s][c] = flushState(bank.z2[s][lane + c]);
+                }
+            mixVoice(m, v, blocks[g], bus + skip, send + skip, start[g], end[g] - start[g], frames);
+        }
+        lane += channels;
+    }
+}
+
+// moves a virtual voice on by the whole buffer without mixing it
+static void skipVoice(Mixer *m, Voice *v, int frames)
+{
+    float rateStart = v->rate * v->doppler * v->rateScale;
+    float rateEnd = v->targetRate * v->targetDoppler * v->rateScale;
+
+    if (v->stream)
+    {
+        Uint32 lastPos = v->source.pos;
+        if (!streamReady(v, frames, SDL_max(rateStart, rateEnd)))
+            return;
+        skipResampler(&v->source, frames, rateStart, rateEnd);
+        streamAdvance(v, lastPos);
+    }
+    else if (v->adpcm)
+    {
+        // a long skip can go round the ring more than once, so count how
+        // far from a position that can't wrap. the decoder starts again
+        // wherever the voice lands when it is mixed
+        Resampler counter = v->source;
+        counter.pos = 0;
+        counter.frames = SDL_MAX_UINT32;
+        skipResampler(&counter, frames, rateStart, rateEnd);
+        v->streamPos += counter.pos;
+        v->source.pos = (v->source.pos + counter.pos) & (MIXER_DECODE_FRAMES - 1);
+        v->source.frac = counter.frac;
+        if (!m->decoders[v->decoder].loop && v->streamPos >= v->adpcm->frames)
+            v->source.finished = 1;
+    }
+    else
+        skipResampler(&v->source, frames, rateStart, rateEnd);
+}
+
+static int louder(const Voice *a, int priority, float audibility)
+{
+    return a->priority > priority || (a->priority == priority && a->audibility > audibility);
+}
+
+static int quieter(const Voice *a, int priority, float audibility)
+{
+    return a->priority < priority || (a->priority == priority && a->audibility < audibility);
+}
+
+// reorders the slots so the count most audible come first, in no
+// particular order. quickselect, so it's linear in the voices on average
+static void pickAudible(Mixer *m, int *slots, int total, int count)
+{
+    int lo = 0, hi = total - 1;
+    int nth = count - 1;
+
+    while (lo < hi)
+    {
+        const Voice *pivot = &m->voices[slots[(lo + hi) / 2]];
+        int priority = pivot->priority;
+        float audibility = pivot->audibility;
+        int i = lo, j = hi;
+
+        while (i <= j)
+        {
+            while (louder(&m->voices[slots[i]], priority, audibility))
+                ++i;
+            while (quieter(&m->voices[slots[j]], priority, audibility))
+                --j;
+            if (i <= j)
+            {
+                int slot = slots[i];
+                slots[i++] = slots[j];
+                slots[j--] = slot;
+            }
+        }
+
+        if (nth <= j)
+            hi = j;
+        else if (nth >= i)
+            lo = i;
+        else
+            break;
+    }
+}
+
+// distance rolloff, pan and doppler of an emitter for the listener
+static void spatialize(Voice *v, int channels, vec3_t listener, vec3_t right, vec3_t listenerVelocity, vec3_t position, vec3_t velocity)
+{
+    vec3_t offset = v3_sub(position, listener);
+    float distance = v3_length(offset);
+    float clamped = SDL_min(SDL_max(distance, MIXER_REF_DISTANCE), MIXER_MAX_DISTANCE);
+    float gain = MIXER_REF_DISTANCE / (MIXER_REF_DISTANCE + MIXER_ROLLOFF * (clamped - MIXER_REF_DISTANCE));
+    float limit = MIXER_SPEED_OF_SOUND / 2;
+    float side = 0, approach = 0, recede = 0;
+    int c;
+
+    if (distance > 0.0001f)
+    {
+        vec3_t direction = v3_divs(offset, distance);
+        side = SDL_min(SDL_max(v3_dot(direction, right), -1.0f), 1.0f);
+        // speeds along the line between them, kept well under the speed of
+        // sound so the shift stays sane
+        approach = SDL_min(SDL_max(v3_dot(listenerVelocity, direction), -limit), limit);
+        recede = SDL_min(SDL_max(v3_dot(velocity, direction), -limit), limit);
+    }
+    v->targetDoppler = (MIXER_SPEED_OF_SOUND + approach) / (MIXER_SPEED_OF_SOUND + recede);
+
+    // constant power, with 1 in both channels straight ahead
+    if (channels == 2)
+    {
+        v->targetPan[0] = gain * sqrtf(1 - side);
+        v->targetPan[1] = gain * sqrtf(1 + side);
+    }
+    else
+        for (c = 0; c < channels; ++c)
+            v->targetPan[c] = gain;
+}
+
+void mixerRender(Mixer *m, Sint16 *stream, int frames)
+{
+    float bus[MIX_BLOCK];
+    float send[MIX_BLOCK];
+    int channels = m->channels;
+    int blockFrames = MIX_BLOCK / channels;
+    vec3_t listener, right, listenerVelocity;
+    Voice *group[FILTER_LANES];
+    int listened;
+    int playing = 0, mixing = 0;
+    int done, i, c, s;
+    Uint64 snapshotStart;
+
+    runCommands(m, frames);
+    snapshotStart = SDL_GetPerformanceCounter();
+    listened = readListener(m, &listener, &right, &listenerVelocity);
+
+    // snapshot the params once and ramp to them over the whole buffer
+    for (i = 0; i < MIXER_MAX_VOICES; ++i)
+    {
+        Voice *v = &m->voices[i];
+        vec3_t position, velocity;
+        BiquadSettings settings[FILTER_STAGES];
+        int voice;
+        if (!v->active)
+            continue;
+        if (!readParams(m, i, &voice, &v->targetVolume, &v->targetRate, &v->targetSend) || voice != v->voice)
+        {
+            v->targetVolume = v->volume;
+            v->targetRate = v->rate;
+            v->targetSend = v->send;
+        }
+
+        // positional voices only move when both reads worked
+        for (c = 0; c < channels; ++c)
+            v->targetPan[c] = v->pan[c];
+        v->targetDoppler = v->doppler;
+        if (listened && readEmitter(m, i, &voice, &position, &velocity) && voice == v->voice)
+            spatialize(v, channels, listener, right, listenerVelocity, position, velocity);
+
+        for (s = 0; s < FILTER_STAGES; ++s)
+            v->targetFilter[s] = v->filter[s];
+        if (readFilter(m, i, &voice, settings) && voice == v->voice)
+            for (s = 0; s < FILTER_STAGES; ++s)
+            {
+                // a different kind of filter doesn't start from the old one's state
+                if (settings[s].type != v->filter[s].type)
+                    for (c = 0; c < MIX_MAX_CHANNELS; ++c)
+                        v->filterZ1[s][c] = v->filterZ2[s][c] = 0;
+                v->targetFilter[s] = settings[s];
+            }
+        m->snapshotVoices++;
+
+        if (v->source.finished)
+            continue;
+        // how loud the voice will be by the end of the buffer
+        v->audibility = v->targetVolume;
+        for (c = 0; c < channels; ++c)
+            v->audibility = SDL_max(v->audibility, v->targetVolume * v->targetPan[c]);
+        if (v->mixed)
+            v->audibility *= MIXER_HYSTERESIS;
+        m->playing[playing++] = i;
+    }
+    m->snapshotTicks += SDL_GetPerformanceCounter() - snapshotStart;
+
+    // the most audible voices are mixed, and the ones that just dropped
+    // out are mixed once more to fade them out. the rest only move on
+    if (playing > m->realVoices)
+        pickAudible(m, m->playing, playing, m->realVoices);
+    for (i = 0; i < playing; ++i)
+    {
+        int slot = m->playing[i];
+        Voice *v = &m->voices[slot];
+        v->audible = i < m->realVoices;
+        if (v->audible || v->mixed)
+        {
+            m->playing[i] = m->playing[mixing];
+            m->playing[mixing++] = slot;
+        }
+        else
+            skipVoice(m, v, frames - v->startFrame);
+    }
+    SDL_AtomicSet(&m->mixedVoices, mixing);
+    SDL_AtomicSet(&m->virtualVoices, playing - mixing);
+
+    // every voice adds into a block of the float bus, which is converted
+    // to 16 bit once
+    for (done = 0; done < frames; done += blockFrames)
+    {
+        int n = SDL_min(blockFrames, frames - done);
+        int grouped = 0, lanes = 0, stages = 0;
+        SDL_memset(bus, 0, n * channels * sizeof(float));
+        if (m->reverb)
+            SDL_memset(send, 0, n * channels * sizeof(float));
+
+        topUpDecoders(m, mixing, done, n, frames);
+
+        // filtered voices wait until there are enough to fill the bank
+        for (i = 0; i < mixing; ++i)
+        {
+            Voice *v = &m->voices[m->playing[i]];
+            int voiceStages;
+            if (v->source.finished)
+                continue;
+            voiceStages = filterStages(v);
+            if (voiceStages == 0)
+            {
+                renderVoice(m, v, bus, send, done, n, frames);
+                continue;
+            }
+            if (lanes + v->source.channels > FILTER_LANES)
+            {
+                renderFiltered(m, group, grouped, stages, bus, send, done, n, frames);
+                grouped = lanes = stages = 0;
+            }
+            group[grouped++] = v;
+            lanes += v->source.channels;
+            stages = SDL_max(stages, voiceStages);
+        }
+        if (grouped)
+            renderFiltered(m, group, grouped, stages, bus, send, done, n, frames);
+
+        if (m->reverb)
+            reverbProcess(m->reverb, send, bus, n, channels);
+
+        convertF32(stream + done * channels, bus, n * channels, m->dither ? m->ditherState : NULL);
+    }
+
+    for (i = 0; i < MIXER_MAX_VOICES; ++i)
+    {
+        Voice *v = &m->voices[i];
+        if (!v->active)
+            continue;
+        v->volume = v->targetVolume;
+        v->rate = v->targetRate;
+        v->send = v->targetSend;
+        for (c = 0; c < channels; ++c)
+            v->pan[c] = v->targetPan[c];
+        v->doppler = v->targetDoppler;
+        for (s = 0; s < FILTER_STAGES; ++s)
+            v->filter[s] = v->targetFilter[s];
+        v->mixed = v->audible && !v->source.finished;
+        v->fresh = 0;
+        v->startFrame = 0;
+        if (v->stopFrame >= 0)
+        {
+            endVoice(m, v);
+            continue;
+        }
+        if (v->source.finished)
+            endVoice(m, v);
+    }
+    m->frame += frames;
+}
@@ -0,0 +1,306 @@
+#ifndef MIXER_H
+#define MIXER_H
+
+#include <SDL.h>
+
+#include "adpcm.h"
+#include "filter.h"
+#include "math_3d.h"
+#include "mix.h"
+#include "resample.h"
+#include "reverb.h"
+#include "sample.h"
+#include "stream.h"
+
+// voices the game can have playing at once. only the most audible
+// MIXER_REAL_VOICES of them are mixed, the rest are virtual and just keep
+// their place in the sample
+#define MIXER_VOICE_BITS 10
+#define MIXER_MAX_VOICES (1 << MIXER_VOICE_BITS)
+#define MIXER_REAL_VOICES 32
+#define MIXER_QUEUE_SIZE 256 // must be a power of two
+
+// compressed voices that can play at once, each decoding into a ring of
+// MIXER_DECODE_FRAMES frames. the ring has to hold a block of the bus at
+// the fastest rate, a block of the sample and the resampler's filter
+#define MIXER_DECODERS 64
+#define MIXER_DECODE_FRAMES 2048 // must be a power of two
+
+// voices mixed last buffer count as this much louder when picking which
+// to mix, so two voices about as loud don't keep swapping
+#define MIXER_HYSTERESIS 1.25f
+
+// distance rolloff for emitters, in world units. full volume up to about
+// where the camera sits from the tank, inverse distance after that
+#define MIXER_REF_DISTANCE 5.0f
+#define MIXER_MAX_DISTANCE 100.0f // no quieter past this
+#define MIXER_ROLLOFF 1.0f
+#define MIXER_SPEED_OF_SOUND 343.0f // world units are meters
+
+// the low-pass cutoff of an emitter with nothing in the way and one fully
+// behind something. occlusion moves between them in octaves
+#define MIXER_OPEN_CUTOFF 20000.0f
+#define MIXER_OCCLUDED_CUTOFF 600.0f
+
+// commands from the game thread to the audio thread
+#define MIXER_PLAY 0
+#define MIXER_STOP 1
+#define MIXER_SET_QUALITY 2
+#define MIXER_SET_DITHER 3
+#define MIXER_SET_PRIORITY 4
+#define MIXER_SET_REAL_VOICES 5
+#define MIXER_SET_REVERB 6
+
+// a voice handle is its slot in the pool plus a generation, so commands
+// for a voice that has since been reused are ignored. generations wrap
+// within the bits above the slot so a handle is never negative
+#define MIXER_VOICE_SLOT(voice) ((voice) & (MIXER_MAX_VOICES - 1))
+#define MIXER_VOICE_GENERATION(voice) ((voice) >> MIXER_VOICE_BITS)
+#define MIXER_GENERATION_MASK ((1 << (31 - MIXER_VOICE_BITS)) - 1)
+
+typedef struct
+{
+    int type;
+    int voice;
+    const float *data;
+    unsigned long frames;
+    int channels;
+    int loop;
+    float volume;
+    float rate; // already scaled for the source's sample rate
+    SampleStream *stream;
+    const AdpcmSample *adpcm;
+    Reverb *reverb;
+    int value; // for the settings
+    Uint64 time; // performance counter, 0 to run at the start of the next buffer
+} MixerCommand;
+
+// continuously changing voice parameters. the game thread can write them
+// at any time and the audio thread takes one consistent snapshot per
+// buffer, retrying if the sequence number shows it raced with a write.
+// the floats are stored as their bits so every access is atomic
+typedef struct
+{
+    SDL_atomic_t sequence; // odd while the game thread is writing
+    SDL_atomic_t voice;
+    SDL_atomic_t volume;
+    SDL_atomic_t rate;
+    SDL_atomic_t send;
+} VoiceParams;
+
+// where a voice is in the world, written the same way as VoiceParams.
+// a voice is only positional once its emitter has been set
+typedef struct
+{
+    SDL_atomic_t sequence;
+    SDL_atomic_t voice;
+    SDL_atomic_t position[3];
+    SDL_atomic_t velocity[3];
+} EmitterParams;
+
+// the filter stages of a voice, written the same way as VoiceParams.
+// a voice is unfiltered until a stage has been set
+typedef struct
+{
+    SDL_atomic_t sequence;
+    SDL_atomic_t voice;
+    SDL_atomic_t type[FILTER_STAGES];
+    SDL_atomic_t cutoff[FILTER_STAGES];
+    SDL_atomic_t q[FILTER_STAGES];
+    SDL_atomic_t gain[FILTER_STAGES];
+} FilterParams;
+
+typedef struct
+{
+    SDL_atomic_t sequence;
+    SDL_atomic_t position[3];
+    SDL_atomic_t right[3]; // unit vector to the listener's right
+    SDL_atomic_t velocity[3];
+} ListenerParams;
+
+// the ring a compressed voice decodes into, a few blocks ahead of where
+// it plays. decoded counts the frames written like streamPos counts the
+// ones consumed, and sampleFrame is where the next block starts
+typedef struct
+{
+    float ring[MIXER_DECODE_FRAMES * ADPCM_MAX_CHANNELS];
+    int used;
+    int loop;
+    Uint32 decoded;
+    unsigned long sampleFrame;
+    // 1 once a sample that doesn't loop is decoded to the end, which is
+    // at end, and 2 once the ring after that is silent
+    int ended;
+    Uint32 end;
+} AdpcmDecoder;
+
+typedef struct
+{
+    int active;
+    int voice;
+    Resampler source;
+    // streamed and compressed voices play a ring as a looping sample, and
+    // streamPos counts the frames they have consumed from it. compressed
+    // ones fill their own ring, the decoder'th in the mixer's pool
+    SampleStream *stream;
+    const AdpcmSample *adpcm;
+    int decoder;
+    Uint32 streamPos;
+    float rateScale; // source rate over mixer rate
+    // the values at the end of the last buffer, each buffer ramps from
+    // these to the latest snapshot of the params
+    float volume;
+    float rate;
+    float targetVolume;
+    float targetRate;
+    float send;
+    float targetSend;
+    // gain of each output channel and pitch from where the voice is,
+    // worked out once a buffer. 1 for voices without an emitter
+    float pan[MIX_MAX_CHANNELS];
+    float doppler;
+    float targetPan[MIX_MAX_CHANNELS];
+    float targetDoppler;
+    // the filter stages ramp the same way, gliding the cutoff in octaves.
+    // each source channel keeps its own state
+    BiquadSettings filter[FILTER_STAGES];
+    BiquadSettings targetFilter[FILTER_STAGES];
+    float filterZ1[FILTER_STAGES][MIX_MAX_CHANNELS];
+    float filterZ2[FILTER_STAGES][MIX_MAX_CHANNELS];
+
+    int priority; // a voice is only virtual while higher priorities fill the mix
+    float audibility; // how loud it will be this buffer
+    int audible; // mixed this buffer
+    int mixed; // mixed last buffer
+    int fresh; // started this buffer, so it doesn't fade in
+    // frames into this buffer the voice starts and stops at, for timed
+    // commands. stopFrame is -1 unless a stop lands in this buffer
+    int startFrame;
+    int stopFrame;
+} Voice;
+
+// everything the audio thread touches is allocated up front in here.
+// the game thread only writes commands and the audio thread only reads
+// them, so the queue needs no locks
+typedef struct
+{
+    int freq;
+    int channels;
+    int quality;
+    int dither;
+    int realVoices;
+    Reverb *reverb; // the send bus goes through this, if there is one
+    Uint32 ditherState[MIX_DITHER_LANES];
+    Voice voices[MIXER_MAX_VOICES];
+    VoiceParams params[MIXER_MAX_VOICES];
+    EmitterParams emitters[MIXER_MAX_VOICES];
+    FilterParams filters[MIXER_MAX_VOICES];
+    ListenerParams listener;
+    AdpcmDecoder decoders[MIXER_DECODERS];
+
+    MixerCommand queue[MIXER_QUEUE_SIZE];
+    SDL_atomic_t head; // next command the game thread writes
+    SDL_atomic_t tail; // next command the audio thread reads
+
+    // the audio thread stores a voice handle here when the voice ends,
+    // whether its sample finished, it was stopped or its slot reused, so
+    // the game thread can reuse the slot and free what it played
+    SDL_atomic_t finished[MIXER_MAX_VOICES];
+
+    // voices mixed and voices skipped last buffer. a voice going virtual
+    // is mixed for one more buffer while it fades out
+    SDL_atomic_t mixedVoices;
+    SDL_atomic_t virtualVoices;
+
+    // audio thread only. turns command times into frames, see mixerSetClock
+    Uint32 frame; // frames rendered so far
+    Uint64 counterFreq;
+    Uint64 clockTime; // 0 until the clock is set
+    Uint32 clockFrame;
+    int scheduleDelay;
+    SDL_atomic_t lateCommands; // timed commands that came too late for their frame
+
+    // audio thread only. time spent reading params and positioning
+    // voices at the start of each buffer, and how many voices that was
+    Uint64 snapshotTicks;
+    unsigned long snapshotVoices;
+    int playing[MIXER_MAX_VOICES]; // scratch for picking the audible voices
+
+    // game thread only
+    int generation[MIXER_MAX_VOICES];
+    int allocated[MIXER_MAX_VOICES];
+} Mixer;
+
+void initMixer(Mixer *m, int freq, int channels);
+
+// game thread. mixerPlay returns a voice handle, or -1 when the sample is
+// empty, every voice is busy or the queue is full
+int mixerPlay(Mixer *m, const Sample *sample, float volume, float rate, int loop);
+int mixerPlayStream(Mixer *m, SampleStream *stream, float volume, float rate);
+
+// plays a compressed sample, decoding it a block at a time as it goes.
+// blocks of every compressed voice in the mix go through the decoder
+// together. a voice that finds all MIXER_DECODERS in use finishes at once
+int mixerPlayAdpcm(Mixer *m, const AdpcmSample *sample, float volume, float rate, int loop);
+void mixerStop(Mixer *m, int voice);
+
+// game thread. true once the audio thread has ended the voice and won't
+// read the sample it played again, however it ended
+int mixerVoiceDone(Mixer *m, int voice);
+
+// like mixerPlay and mixerStop, landing on the frame of the mixer's output
+// that time, a performance counter value, maps to on its clock. commands
+// run in order, so everything sent after a timed command waits for it
+int mixerPlayAt(Mixer *m, const Sample *sample, float volume, float rate, int loop, Uint64 time);
+void mixerStopAt(Mixer *m, int voice, Uint64 time);
+void mixerSetVolume(Mixer *m, int voice, float volume);
+void mixerSetRate(Mixer *m, int voice, float rate);
+
+// how much of a voice goes to the reverb, on top of its dry signal.
+// voices start with no send
+void mixerSetSend(Mixer *m, int voice, float send);
+void mixerSetQuality(Mixer *m, int quality);
+void mixerSetDither(Mixer *m, int dither);
+
+// higher priority voices are always mixed before lower ones, however
+// quiet. voices start at 0
+void mixerSetPriority(Mixer *m, int voice, int priority);
+
+// the reverb the send bus runs through, or NULL for none. the mixer
+// clears it when it switches to it. a reverb can only be freed once the
+// mixer has moved off it, so close the audio device first
+void mixerSetReverb(Mixer *m, Reverb *reverb);
+
+// how many voices are mixed at most, up to MIXER_MAX_VOICES
+void mixerSetRealVoices(Mixer *m, int count);
+
+// makes a voice positional. distance sets its volume on top of
+// mixerSetVolume, the listener's right its pan, and the velocities their
+// doppler shift on top of mixerSetRate. velocities are units per second
+void mixerSetEmitter(Mixer *m, int voice, vec3_t position, vec3_t velocity);
+
+// sets one of a voice's FILTER_STAGES biquads, FILTER_NONE to take it out.
+// filtered voices are run through the filter bank FILTER_LANES source
+// channels at a time
+void mixerSetFilter(Mixer *m, int voice, int stage, const BiquadSettings *settings);
+
+// muffles a voice that is 0 (not at all) to 1 (fully) behind something,
+// with a low-pass in its last filter stage
+void mixerSetOcclusion(Mixer *m, int voice, float occlusion);
+
+// the listener is the camera of view, which can only rotate and translate
+void mixerSetListener(Mixer *m, mat4_t view, vec3_t velocity);
+
+// audio thread. frame of the mixer's output, counted from its first
+// mixerRender, was handed to the device at time. a timed command plays
+// delay frames after the frame its time maps to, so delay has to cover
+// how far ahead of the device the mixer renders. until the clock is set
+// timed commands run at the start of the next buffer
+void mixerSetClock(Mixer *m, Uint64 time, Uint32 frame, int delay);
+
+// audio thread. applies the queued commands, mixes the most audible
+// voices into a float bus and converts that once into stream, which holds
+// frames frames of interleaved 16 bit samples. the others only move on
+void mixerRender(Mixer *m, Sint16 *stream, int frames);
+
+#endif
@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "offline.h"
+
+int loadAutomation(Automation *a, const char *path)
+{
+    char line[256];
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        printf("Could not open %s\n", path);
+        return 0;
+    }
+
+    a->count = 0;
+    while (fgets(line, sizeof(line), file) && a->count < AUTOMATION_MAX_KEYS)
+    {
+        float time, pitch, volume;
+        if (line[0] == '#')
+            continue;
+        if (sscanf(line, "%f %f %f", &time, &pitch, &volume) != 3)
+            continue;
+        a->time[a->count] = time;
+        a->pitch[a->count] = pitch;
+        a->volume[a->count] = volume;
+        ++a->count;
+    }
+    fclose(file);
+
+    if (a->count == 0)
+    {
+        printf("No automation keys in %s\n", path);
+        return 0;
+    }
+    return 1;
+}
+
+static void sampleAutomation(const Automation *a, float time, float *pitch, float *volume)
+{
+    int i = 0;
+    while (i < a->count - 1 && a->time[i + 1] <= time)
+        ++i;
+
+    if (i == a->count - 1 || time <= a->time[i])
+    {
+        *pitch = a->pitch[i];
+        *volume = a->volume[i];
+    }
+    else
+    {
+        float t = (time - a->time[i]) / (a->time[i + 1] - a->time[i]);
+        *pitch = a->pitch[i] + (a->pitch[i + 1] - a->pitch[i]) * t;
+        *volume = a->volume[i] + (a->volume[i + 1] - a->volume[i]) * t;
+    }
+}
+
+static void writeWavHeader(SDL_RWops *out, int freq, int channels, Uint32 dataSize)
+{
+    SDL_RWwrite(out, "RIFF", 1, 4);
+    SDL_WriteLE32(out, 36 + dataSize);
+    SDL_RWwrite(out, "WAVEfmt ", 1, 8);
+    SDL_WriteLE32(out, 16);
+    SDL_WriteLE16(out, 1); // pcm
+    SDL_WriteLE16(out, channels);
+    SDL_WriteLE32(out, freq);
+    SDL_WriteLE32(out, freq * channels * sizeof(Sint16));
+    SDL_WriteLE16(out, channels * sizeof(Sint16));
+    SDL_WriteLE16(out, 16);
+    SDL_RWwrite(out, "data", 1, 4);
+    SDL_WriteLE32(out, dataSize);
+}
+
+int renderOffline(Mixer *m, int voice, int bufferFrames, const Automation *a, const char *outPath)
+{
+    int freq = m->freq;
+    int channels = m->channels;
+    unsigned long total = (unsigned long)(a->time[a->count - 1] * freq);
+    unsigned long done = 0;
+    Uint64 mixTicks = 0;
+    Uint64 start, elapsed;
+    double seconds;
+    Sint16 *buffer;
+
+    SDL_RWops *out = SDL_RWFromFile(outPath, "wb");
+    if (out == NULL)
+    {
+        printf("Could not open %s: %s\n", outPath, SDL_GetError());
+        return 0;
+    }
+
+    buffer = malloc(bufferFrames * channels * sizeof(Sint16));
+    // sizes are patched in once we know them
+    writeWavHeader(out, freq, channels, 0);
+
+    start = SDL_GetPerformanceCounter();
+    while (done < total)
+    {
+        int frames = SDL_min(bufferFrames, total - done);
+        float pitch, volume;
+        Uint64 mixStart;
+
+        sampleAutomation(a, (float)done / freq, &pitch, &volume);
+        mixerSetRate(m, voice, 1.0f + pitch);
+        mixerSetVolume(m, voice, volume);
+
+        mixStart = SDL_GetPerformanceCounter();
+        mixerRender(m, buffer, frames);
+        mixTicks += SDL_GetPerformanceCounter() - mixStart;
+
+        SDL_RWwrite(out, buffer, sizeof(Sint16), frames * channels);
+        done += frames;
+    }
+    elapsed = SDL_GetPerformanceCounter() - start;
+
+    SDL_RWseek(out, 0, RW_SEEK_SET);
+    writeWavHeader(out, freq, channels, done * channels * sizeof(Sint16));
+    SDL_RWclose(out);
+    free(buffer);
+
+    seconds = (double)elapsed / SDL_GetPerformanceFrequency();
+    printf("rendered %lu frames (%.2f s of audio) to %s in %.3f s, %.1fx real time\n",
+        done, (double)done / freq, outPath, seconds, done / (seconds * freq));
+    printf("mixer: %.0f samples/sec, total with file output: %.0f samples/sec\n",
+        done * channels * (double)SDL_GetPerformanceFrequency() / SDL_max(mixTicks, 1),
+        done * channels / seconds);
+    return 1;
+}
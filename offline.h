@@ -0,0 +1,29 @@
+#ifndef OFFLINE_H
+#define OFFLINE_H
+
+#include "mixer.h"
+
+#define AUTOMATION_MAX_KEYS 1024
+
+// pitch and volume keyframes for a voice, linearly interpolated.
+// pitch is the same 0 - 1 pitchShift the game uses, so the rate is 1 + pitch
+typedef struct
+{
+    int count;
+    float time[AUTOMATION_MAX_KEYS];
+    float pitch[AUTOMATION_MAX_KEYS];
+    float volume[AUTOMATION_MAX_KEYS];
+} Automation;
+
+// reads "time pitch volume" lines, one key per line, times in seconds and
+// increasing. blank lines and lines starting with # are skipped.
+// returns 0 if the file can't be read or has no keys
+int loadAutomation(Automation *a, const char *path);
+
+// runs the mixer with no audio device, driving voice from the automation
+// once per buffer of bufferFrames frames until the last key, and streams
+// the result to a 16 bit wav file as fast as it can. prints the throughput.
+// returns 0 if the file can't be written
+int renderOffline(Mixer *m, int voice, int bufferFrames, const Automation *a, const char *outPath);
+
+#endif
@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "output.h"
+
+static void recordRender(AudioOutput *o, Uint64 start)
+{
+    Uint64 elapsed = SDL_GetPerformanceCounter() - start;
+    SDL_AtomicAdd(&o->renders, 1);
+    SDL_AtomicAdd(&o->renderMicros, (int)(elapsed * 1000000 / SDL_GetPerformanceFrequency()));
+}
+
+// the callback backend's device callback
+static void outputCallback(void *userdata, Uint8 *stream, int len)
+{
+    AudioOutput *o = userdata;
+    Uint64 start = beginAudioTiming(&o->timing);
+    int frames = len / (sizeof(Sint16) * o->channels);
+    // the device plays this buffer once the one it is on now runs out
+    o->render(o->userdata, (Sint16*)stream, frames, start, frames);
+    endAudioTiming(&o->timing, start);
+    recordRender(o, start);
+}
+
+static void printDrivers()
+{
+    int i;
+    printf("audio drivers:");
+    for (i = 0; i < SDL_GetNumAudioDrivers(); ++i)
+        printf(" %s", SDL_GetAudioDriver(i));
+    printf("\n");
+}
+
+int openAudioOutput(AudioOutput *o, const char *driver, int backend, int freq, int channels, int samples, int target, OutputRenderFunc render, void *userdata)
+{
+    SDL_AudioSpec want, have;
+
+    SDL_memset(o, 0, sizeof(AudioOutput));
+    o->backend = backend;
+    o->render = render;
+    o->userdata = userdata;
+
+    if (driver && SDL_AudioInit(driver) < 0)
+    {
+        printf("Couldn't start audio driver %s: %s\n", driver, SDL_GetError());
+        printDrivers();
+        return 0;
+    }
+
+    SDL_zero(want);
+    want.freq = freq;
+    want.format = AUDIO_S16SYS;
+    want.channels = channels;
+    want.samples = samples;
+    // the queue backend leaves SDL to run its own callback off the queue
+    if (backend == OUTPUT_CALLBACK)
+    {
+        want.callback = outputCallback;
+        want.userdata = o;
+    }
+
+    // SDL converts if the device can't do the format, so the mixer's
+    // format is what the render function always gets
+    o->device = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0);
+    if (o->device == 0)
+    {
+        printf("Couldn't open audio: %s\n", SDL_GetError());
+        printDrivers();
+        return 0;
+    }
+
+    o->freq = have.freq;
+    o->channels = have.channels;
+    o->samples = have.samples;
+    if (backend == OUTPUT_QUEUE)
+    {
+        o->target = (target + OUTPUT_QUEUE_BLOCK - 1) / OUTPUT_QUEUE_BLOCK * OUTPUT_QUEUE_BLOCK;
+        // the block on top of the target, plus the device's own buffer
+        // SDL pulls off the queue ahead of playing it
+        o->latency = o->target + OUTPUT_QUEUE_BLOCK + o->samples;
+        o->block = malloc(OUTPUT_QUEUE_BLOCK * o->channels * sizeof(Sint16));
+        o->minQueued = SDL_MAX_SINT32;
+    }
+    else
+        o->latency = 2 * o->samples;
+    initAudioTiming(&o->timing, o->freq, o->samples);
+    return 1;
+}
+
+void closeAudioOutput(AudioOutput *o)
+{
+    if (o->device)
+        SDL_CloseAudioDevice(o->device);
+    o->device = 0;
+    free(o->block);
+    o->block = NULL;
+}
+
+void startAudioOutput(AudioOutput *o)
+{
+    // the queue starts full so the first frames don't underrun
+    pumpAudioOutput(o);
+    SDL_PauseAudioDevice(o->device, 0);
+}
+
+void pumpAudioOutput(AudioOutput *o)
+{
+    int frameBytes = o->channels * sizeof(Sint16);
+    int queued;
+
+    if (o->backend != OUTPUT_QUEUE || o->device == 0)
+        return;
+
+    // the first pump fills the queue before the device starts
+    queued = SDL_GetQueuedAudioSize(o->device) / frameBytes;
+    if (o->pumps > 0)
+    {
+        if (queued == 0)
+            ++o->underruns;
+        o->minQueued = SDL_min(o->minQueued, queued);
+        o->maxQueued = SDL_max(o->maxQueued, queued);
+        o->queuedSum += queued;
+    }
+    ++o->pumps;
+
+    while (queued < o->target)
+    {
+        Uint64 start = SDL_GetPerformanceCounter();
+        // SDL's device buffer plays out before anything still queued
+        o->render(o->userdata, o->block, OUTPUT_QUEUE_BLOCK, start, queued + o->samples);
+        recordRender(o, start);
+        if (SDL_QueueAudio(o->device, o->block, OUTPUT_QUEUE_BLOCK * frameBytes) < 0)
+        {
+            printf("Couldn't queue audio: %s\n", SDL_GetError());
+            break;
+        }
+        queued += OUTPUT_QUEUE_BLOCK;
+    }
+}
+
+void printAudioOutput(AudioOutput *o)
+{
+    int renders = SDL_AtomicGet(&o->renders);
+    int frames = o->backend == OUTPUT_QUEUE ? OUTPUT_QUEUE_BLOCK : o->samples;
+    double seconds = (double)renders * frames / SDL_max(o->freq, 1);
+    double renderMs = SDL_AtomicGet(&o->renderMicros) / 1000.0;
+
+    printf("audio output: %s backend on the %s driver, %d hz, %d channels, %d frame device buffer\n",
+        outputBackendName(o->backend), SDL_GetCurrentAudioDriver() ? SDL_GetCurrentAudioDriver() : "no",
+        o->freq, o->channels, o->samples);
+    printf("  latency up to %.1f ms", o->latency * 1000.0 / SDL_max(o->freq, 1));
+    if (o->backend == OUTPUT_QUEUE && o->pumps > 1)
+        printf(", queued %.1f / %.1f / %.1f ms min / mean / max, %d underruns",
+            o->minQueued * 1000.0 / o->freq, o->queuedSum / (o->pumps - 1) * 1000.0 / o->freq,
+            o->maxQueued * 1000.0 / o->freq, o->underruns);
+    printf("\n");
+    printf("  %d renders, %.3f ms each, %.2f%% of a core\n", renders, renderMs / SDL_max(renders, 1),
+        seconds > 0 ? renderMs / 10 / seconds : 0.0);
+    if (o->backend == OUTPUT_CALLBACK)
+        printAudioTiming(&o->timing);
+}
+
+const char *outputBackendName(int backend)
+{
+    return backend == OUTPUT_QUEUE ? "queue" : "callback";
+}
@@ -0,0 +1,74 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <SDL.h>
+
+#include "timing.h"
+
+// how mixed frames get to the device. the callback backend renders on
+// SDL's audio thread whenever the device wants a buffer, the queue
+// backend renders on the game thread and pushes blocks with SDL_QueueAudio
+// to stay a target amount ahead
+#define OUTPUT_CALLBACK 0
+#define OUTPUT_QUEUE 1
+
+// frames the queue backend renders and queues at a time
+#define OUTPUT_QUEUE_BLOCK 512
+
+// renders frames frames of 16 bit samples in the device's channels into
+// stream. time is when they were asked for, a performance counter value,
+// and queued how many frames the device had to play before them
+typedef void (*OutputRenderFunc)(void *userdata, Sint16 *stream, int frames, Uint64 time, int queued);
+
+typedef struct
+{
+    int backend;
+    SDL_AudioDeviceID device;
+    int freq;
+    int channels;
+    int samples; // frames in a device buffer
+    int target; // frames the queue backend keeps queued
+    // most frames from asking for a render to hearing its first frame, so
+    // timed sounds can be scheduled this far ahead
+    int latency;
+    OutputRenderFunc render;
+    void *userdata;
+
+    // callback backend, how long each callback takes against its budget
+    AudioTiming timing;
+
+    // queue backend, game thread only. what was still queued each pump,
+    // which is the latency, and pumps that found the device had run dry
+    Sint16 *block;
+    int pumps;
+    int minQueued;
+    int maxQueued;
+    double queuedSum;
+    int underruns;
+
+    // either backend. written by whichever thread renders
+    SDL_atomic_t renders;
+    SDL_atomic_t renderMicros;
+} AudioOutput;
+
+// opens the default device of driver, or of SDL's own choice (or
+// SDL_AUDIODRIVER) if driver is NULL, with a buffer of samples frames.
+// the queue backend keeps target frames queued, rounded up to whole
+// blocks. the device starts paused. returns 0 and lists the drivers if it
+// can't be opened
+int openAudioOutput(AudioOutput *o, const char *driver, int backend, int freq, int channels, int samples, int target, OutputRenderFunc render, void *userdata);
+
+void closeAudioOutput(AudioOutput *o);
+
+void startAudioOutput(AudioOutput *o);
+
+// game thread, once a frame. the queue backend renders blocks until the
+// device has its target queued, the callback backend does nothing
+void pumpAudioOutput(AudioOutput *o);
+
+// the backend, driver and device, the latency and what rendering costs
+void printAudioOutput(AudioOutput *o);
+
+const char *outputBackendName(int backend);
+
+#endif
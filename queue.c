@@ -0,0 +1,156 @@
+#include <stdio.h>
+
+#include "queue.h"
+
+#define QUEUE_DEPTH_SHIFT 0
+#define QUEUE_MESH_SHIFT (QUEUE_DEPTH_SHIFT + QUEUE_DEPTH_BITS)
+#define QUEUE_VAO_SHIFT (QUEUE_MESH_SHIFT + QUEUE_MESH_BITS)
+#define QUEUE_PROGRAM_SHIFT (QUEUE_VAO_SHIFT + QUEUE_VAO_BITS)
+#define QUEUE_PASS_SHIFT (QUEUE_PROGRAM_SHIFT + QUEUE_PROGRAM_BITS)
+
+#define FIELD(value, bits, shift) (((Uint64)(value) & ((1ull << (bits)) - 1)) << (shift))
+
+void initRenderQueue(RenderQueue *q)
+{
+    SDL_memset(q, 0, sizeof(RenderQueue));
+    q->order = q->indices[0];
+}
+
+void beginRenderQueue(RenderQueue *q)
+{
+    q->count = 0;
+}
+
+Uint64 renderKey(int pass, GLuint program, GLuint vao, int mesh, float depth)
+{
+    Uint32 depthBits = (Uint32)(SDL_max(0.0f, SDL_min(depth, 1.0f)) * ((1 << QUEUE_DEPTH_BITS) - 1));
+    return FIELD(pass, QUEUE_PASS_BITS, QUEUE_PASS_SHIFT)
+        | FIELD(program, QUEUE_PROGRAM_BITS, QUEUE_PROGRAM_SHIFT)
+        | FIELD(vao, QUEUE_VAO_BITS, QUEUE_VAO_SHIFT)
+        | FIELD(mesh, QUEUE_MESH_BITS, QUEUE_MESH_SHIFT)
+        | FIELD(depthBits, QUEUE_DEPTH_BITS, QUEUE_DEPTH_SHIFT);
+}
+
+int queueMesh(RenderQueue *q, Uint64 key, GLuint program, GLuint vao, const Mesh *m, int first, int count)
+{
+    if (q->count == QUEUE_MAX_ITEMS)
+        return 0;
+    if (count <= 0)
+        return 1;
+    QueueItem *item = &q->items[q->count++];
+    item->key = key;
+    item->program = program;
+    item->vao = vao;
+    item->mesh = m;
+    item->first = first;
+    item->count = count;
+    return 1;
+}
+
+void sortRenderQueue(RenderQueue *q)
+{
+    int i, digit, from = 0;
+    int counts[256];
+
+    for (i = 0; i < q->count; ++i)
+    {
+        q->keys[0][i] = q->items[i].key;
+        q->indices[0][i] = i;
+    }
+
+    // a byte at a time from the bottom. each pass is stable, so after the
+    // last the keys are in order and equal ones in queued order
+    q->passes = 0;
+    for (digit = 0; digit < 8; ++digit)
+    {
+        int shift = digit * 8;
+        SDL_memset(counts, 0, sizeof(counts));
+        for (i = 0; i < q->count; ++i)
+            ++counts[(q->keys[from][i] >> shift) & 0xff];
+        // every key has the same byte here, so nothing would move. most
+        // of them do, a frame only uses a few programs and meshes
+        if (q->count == 0 || counts[(q->keys[from][0] >> shift) & 0xff] == q->count)
+            continue;
+
+        int offset = 0;
+        for (i = 0; i < 256; ++i)
+        {
+            int c = counts[i];
+            counts[i] = offset;
+            offset += c;
+        }
+        int to = 1 - from;
+        for (i = 0; i < q->count; ++i)
+        {
+            int slot = counts[(q->keys[from][i] >> shift) & 0xff]++;
+            q->keys[to][slot] = q->keys[from][i];
+            q->indices[to][slot] = q->indices[from][i];
+        }
+        from = to;
+        ++q->passes;
+    }
+    q->order = q->indices[from];
+}
+
+// draws the run of items gathered in batch
+static void flushRun(RenderQueue *q, DrawBatch *batch, InstanceBuffer *instances)
+{
+    if (batch->count == 0)
+        return;
+    submitDrawBatch(batch, instances);
+    q->calls += batch->calls;
+    ++q->runs;
+    beginDrawBatch(batch);
+}
+
+void submitRenderQueue(RenderQueue *q, DrawBatch *batch, InstanceBuffer *instances)
+{
+    GLuint program = 0, vao = 0;
+    int bound = 0;
+
+    q->binds = 0;
+    q->avoided = 0;
+    q->runs = 0;
+    q->calls = 0;
+    beginDrawBatch(batch);
+    for (int i = 0; i < q->count; ++i)
+    {
+        QueueItem *item = &q->items[q->order[i]];
+        int newProgram = !bound || item->program != program;
+        int newVAO = !bound || item->vao != vao;
+
+        // the run so far has to go out with the state it was gathered for
+        if (newProgram || newVAO)
+            flushRun(q, batch, instances);
+        if (newProgram)
+        {
+            glUseProgram(item->program);
+            program = item->program;
+            ++q->binds;
+        }
+        else
+            ++q->avoided;
+        if (newVAO)
+        {
+            glBindVertexArray(item->vao);
+            vao = item->vao;
+            ++q->binds;
+        }
+        else
+            ++q->avoided;
+        bound = 1;
+
+        if (!batchMesh(batch, item->mesh, item->first, item->count))
+        {
+            flushRun(q, batch, instances);
+            batchMesh(batch, item->mesh, item->first, item->count);
+        }
+    }
+    flushRun(q, batch, instances);
+}
+
+void printRenderQueue(RenderQueue *q)
+{
+    printf("render queue: %d draws in %d runs, %d calls, %d binds, %d avoided, sorted in %d passes\n",
+        q->count, q->runs, q->calls, q->binds, q->avoided, q->passes);
+}
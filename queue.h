@@ -0,0 +1,82 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <SDL.h>
+#include <gl\glew.h>
+
+#include "batch.h"
+#include "instance.h"
+#include "mesh.h"
+
+#define QUEUE_MAX_ITEMS BATCH_MAX_DRAWS
+
+// the fields of a sort key, from the top bit down. draws sort by pass,
+// then by the state they need, then front to back. program and vao names
+// only keep their low bits, names that share them still draw right but
+// may not end up next to each other
+#define QUEUE_PASS_BITS 4
+#define QUEUE_PROGRAM_BITS 12
+#define QUEUE_VAO_BITS 12
+#define QUEUE_MESH_BITS 12
+#define QUEUE_DEPTH_BITS 24
+
+// count instances of a mesh, with the matrices from instance first on,
+// and what has to be bound to draw them
+typedef struct
+{
+    Uint64 key;
+    GLuint program;
+    GLuint vao;
+    const Mesh *mesh;
+    int first;
+    int count;
+} QueueItem;
+
+// a frame's draws in any order. sorting by key puts the ones that need
+// the same program and vao together, and submitting binds each only when
+// it changes and sends every run of draws with the same state as one
+// batch. only used on whichever thread owns the context, which is the
+// render thread once it is started
+typedef struct
+{
+    int count;
+    QueueItem items[QUEUE_MAX_ITEMS];
+    // the keys and item indices, sorted into the other half a digit at a
+    // time. order is the sorted one after sortRenderQueue
+    Uint64 keys[2][QUEUE_MAX_ITEMS];
+    int indices[2][QUEUE_MAX_ITEMS];
+    int *order;
+
+    // what the last submit did. the binds avoided are against binding the
+    // program and vao for every draw
+    int binds;
+    int avoided;
+    int runs;
+    int calls;
+    int passes; // digits the last sort had to move, of 8
+} RenderQueue;
+
+void initRenderQueue(RenderQueue *q);
+
+// empties the queue for the next frame
+void beginRenderQueue(RenderQueue *q);
+
+// depth is 0 at the near plane and 1 at the far one. passes that want
+// back to front give 1 - depth
+Uint64 renderKey(int pass, GLuint program, GLuint vao, int mesh, float depth);
+
+// adds a draw to the queue. returns 0 if it is full
+int queueMesh(RenderQueue *q, Uint64 key, GLuint program, GLuint vao, const Mesh *m, int first, int count);
+
+// orders the draws by key, keeping the order they were queued in where
+// keys are the same
+void sortRenderQueue(RenderQueue *q);
+
+// binds and draws everything in key order, through batch. leaves the last
+// program and vao bound
+void submitRenderQueue(RenderQueue *q, DrawBatch *batch, InstanceBuffer *instances);
+
+// what the last frame bound and how many calls it took
+void printRenderQueue(RenderQueue *q);
+
+#endif
@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "render.h"
+
+void initRenderList(RenderList *l)
+{
+    SDL_memset(l, 0, sizeof(RenderList));
+}
+
+void freeRenderList(RenderList *l)
+{
+    free(l->commands);
+    free(l->matrices);
+    SDL_memset(l, 0, sizeof(RenderList));
+}
+
+mat4_t *listMatrices(RenderList *l, int count)
+{
+    if (count > l->matrixCapacity)
+    {
+        l->matrixCapacity = SDL_max(count, l->matrixCapacity * 2);
+        l->matrices = realloc(l->matrices, l->matrixCapacity * sizeof(mat4_t));
+    }
+    l->matrixCount = count;
+    return l->matrices;
+}
+
+static RenderCommand *addCommand(RenderList *l, int type)
+{
+    if (l->commandCount == l->commandCapacity)
+    {
+        l->commandCapacity = SDL_max(16, l->commandCapacity * 2);
+        l->commands = realloc(l->commands, l->commandCapacity * sizeof(RenderCommand));
+    }
+    RenderCommand *c = &l->commands[l->commandCount++];
+    SDL_memset(c, 0, sizeof(RenderCommand));
+    c->type = type;
+    return c;
+}
+
+void listMesh(RenderList *l, int mesh, int pass, float depth, int first, int count)
+{
+    if (count <= 0)
+        return;
+    RenderCommand *c = addCommand(l, RENDER_MESH);
+    c->mesh = mesh;
+    c->pass = pass;
+    c->depth = depth;
+    c->first = first;
+    c->count = count;
+}
+
+void listStats(RenderList *l)
+{
+    addCommand(l, RENDER_STATS);
+}
+
+// draws a list and notes when, on whichever thread has the context
+static void drawList(Renderer *r, const RenderList *l)
+{
+    int slot = l->frame % RENDER_TIMELINE_FRAMES;
+    r->simStart[slot] = l->recordStart;
+    r->simEnd[slot] = l->recordEnd;
+    r->recorded = l->frame + 1;
+    r->drawStart[slot] = SDL_GetPerformanceCounter();
+    r->draw(l, r->userdata);
+    r->drawEnd[slot] = SDL_GetPerformanceCounter();
+    ++r->drawn;
+}
+
+static int renderThread(void *data)
+{
+    Renderer *r = data;
+
+    SDL_GL_MakeCurrent(r->window, r->context);
+    for (;;)
+    {
+        if (SDL_SemTryWait(r->full) != 0)
+        {
+            ++r->idle;
+            SDL_SemWait(r->full);
+        }
+        if (SDL_AtomicGet(&r->quit))
+            break;
+        drawList(r, &r->lists[r->drawing]);
+        r->drawing ^= 1;
+        SDL_SemPost(r->empty);
+    }
+    SDL_GL_MakeCurrent(r->window, NULL);
+    return 0;
+}
+
+void startRenderer(Renderer *r, SDL_Window *window, SDL_GLContext context, int threaded, RenderListFunc draw, void *userdata)
+{
+    SDL_memset(r, 0, sizeof(Renderer));
+    initRenderList(&r->lists[0]);
+    initRenderList(&r->lists[1]);
+    r->window = window;
+    r->context = context;
+    r->draw = draw;
+    r->userdata = userdata;
+    r->threaded = threaded;
+    if (!threaded)
+        return;
+
+    r->empty = SDL_CreateSemaphore(2);
+    r->full = SDL_CreateSemaphore(0);
+    // a context can only be current on one thread at a time
+    SDL_GL_MakeCurrent(window, NULL);
+    r->thread = SDL_CreateThread(renderThread, "render", r);
+    if (!r->thread)
+    {
+        printf("Could not start the render thread, drawing on the game thread: %s\n", SDL_GetError());
+        SDL_GL_MakeCurrent(window, context);
+        SDL_DestroySemaphore(r->empty);
+        SDL_DestroySemaphore(r->full);
+        r->empty = NULL;
+        r->full = NULL;
+        r->threaded = 0;
+    }
+}
+
+void stopRenderer(Renderer *r)
+{
+    if (r->thread)
+    {
+        SDL_AtomicSet(&r->quit, 1);
+        SDL_SemPost(r->full);
+        SDL_WaitThread(r->thread, NULL);
+        r->thread = NULL;
+        SDL_DestroySemaphore(r->empty);
+        SDL_DestroySemaphore(r->full);
+        SDL_GL_MakeCurrent(r->window, r->context);
+    }
+    freeRenderList(&r->lists[0]);
+    freeRenderList(&r->lists[1]);
+}
+
+RenderList *beginFrame(Renderer *r)
+{
+    if (r->thread && SDL_SemTryWait(r->empty) != 0)
+    {
+        SDL_AtomicAdd(&r->stalls, 1);
+        SDL_SemWait(r->empty);
+    }
+    RenderList *l = &r->lists[r->recording];
+    l->frame = r->frames++;
+    l->commandCount = 0;
+    l->matrixCount = 0;
+    l->recordStart = SDL_GetPerformanceCounter();
+    return l;
+}
+
+void endFrame(Renderer *r)
+{
+    RenderList *l = &r->lists[r->recording];
+    l->recordEnd = SDL_GetPerformanceCounter();
+    r->recording ^= 1;
+    if (r->thread)
+        SDL_SemPost(r->full);
+    else
+        drawList(r, l);
+}
+
+// marks where frames between first and last were busy on a line of the
+// timeline, with the last digit of their number
+static void markLane(char *line, const Uint64 *starts, const Uint64 *ends, int first, int last, Uint64 t0, Uint64 span)
+{
+    for (int f = first; f <= last; ++f)
+    {
+        int slot = f % RENDER_TIMELINE_FRAMES;
+        int c0 = (int)((starts[slot] - t0) * RENDER_TIMELINE_COLUMNS / span);
+        int c1 = (int)((ends[slot] - t0) * RENDER_TIMELINE_COLUMNS / span);
+        for (int c = c0; c <= SDL_max(c0, c1 - 1) && c < RENDER_TIMELINE_COLUMNS; ++c)
+            line[c] = '0' + f % 10;
+    }
+}
+
+void printRenderer(Renderer *r)
+{
+    double msPerTick = 1000.0 / SDL_GetPerformanceFrequency();
+    // frames first to drawn - 1 are drawn, and first to recorded - 1
+    // recorded. called while drawing one, it is recorded but not drawn
+    int first = SDL_max(0, r->recorded - RENDER_TIMELINE_FRAMES);
+    int frames = r->drawn - first;
+    Uint64 sim = 0, draw = 0, overlap = 0;
+    int f, g;
+
+    printf("renderer: %s, game waited for a list %d times, render thread for a frame %d times\n",
+        r->threaded ? "own thread" : "game thread", SDL_AtomicGet(&r->stalls), r->idle);
+    if (frames < 2)
+        return;
+
+    for (f = first; f < r->drawn; ++f)
+    {
+        int slot = f % RENDER_TIMELINE_FRAMES;
+        draw += r->drawEnd[slot] - r->drawStart[slot];
+    }
+    // the game is at most two frames ahead of the render thread, so a
+    // frame's recording can only overlap drawing the two before it
+    for (g = first + 1; g < r->recorded; ++g)
+    {
+        int slot = g % RENDER_TIMELINE_FRAMES;
+        sim += r->simEnd[slot] - r->simStart[slot];
+        for (f = SDL_max(g - 2, first); f < g && f < r->drawn; ++f)
+        {
+            int drawSlot = f % RENDER_TIMELINE_FRAMES;
+            Uint64 start = SDL_max(r->drawStart[drawSlot], r->simStart[slot]);
+            Uint64 end = SDL_min(r->drawEnd[drawSlot], r->simEnd[slot]);
+            overlap += end > start ? end - start : 0;
+        }
+    }
+    Uint64 period = r->drawEnd[(r->drawn - 1) % RENDER_TIMELINE_FRAMES] - r->drawEnd[first % RENDER_TIMELINE_FRAMES];
+    printf("  last %d frames: record %.3f ms, draw %.3f ms, a frame every %.3f ms, %.1f%% of recording overlapped drawing\n",
+        frames, sim * msPerTick / (r->recorded - 1 - first), draw * msPerTick / frames, period * msPerTick / (frames - 1),
+        sim ? 100.0 * overlap / sim : 0.0);
+
+    // the last few frames, recording above and drawing below
+    int shown = SDL_max(r->drawn - RENDER_TIMELINE_SHOWN, first);
+    int last = r->recorded - 1;
+    Uint64 t0 = r->simStart[shown % RENDER_TIMELINE_FRAMES];
+    Uint64 t1 = SDL_max(r->drawEnd[(r->drawn - 1) % RENDER_TIMELINE_FRAMES], r->simEnd[last % RENDER_TIMELINE_FRAMES]);
+    Uint64 span = SDL_max(t1 - t0, 1);
+    char record[RENDER_TIMELINE_COLUMNS + 1], drawing[RENDER_TIMELINE_COLUMNS + 1];
+    SDL_memset(record, ' ', RENDER_TIMELINE_COLUMNS);
+    SDL_memset(drawing, ' ', RENDER_TIMELINE_COLUMNS);
+    record[RENDER_TIMELINE_COLUMNS] = drawing[RENDER_TIMELINE_COLUMNS] = 0;
+    markLane(record, r->simStart, r->simEnd, shown, last, t0, span);
+    markLane(drawing, r->drawStart, r->drawEnd, shown, r->drawn - 1, t0, span);
+    printf("  frames %d to %d, a column is %.3f ms\n", shown, last, span * msPerTick / RENDER_TIMELINE_COLUMNS);
+    printf("  record |%s|\n", record);
+    printf("  draw   |%s|\n", drawing);
+}
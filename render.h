@@ -0,0 +1,122 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <SDL.h>
+
+#include "math_3d.h"
+
+// frames the timeline remembers, and how many of them it prints across
+// RENDER_TIMELINE_COLUMNS characters
+#define RENDER_TIMELINE_FRAMES 64
+#define RENDER_TIMELINE_SHOWN 6
+#define RENDER_TIMELINE_COLUMNS 96
+
+typedef enum
+{
+    RENDER_MESH, // count instances of a mesh
+    RENDER_STATS // prints the renderer's stats once the frame is drawn
+} RenderCommandType;
+
+// one thing for a frame to do, in the game's meshes and passes. nothing in
+// it is gl, the render thread works out the state to draw it with
+typedef struct
+{
+    int type;
+    int mesh; // handle in the mesh registry
+    int pass;
+    float depth; // 0 at the near plane and 1 at the far one
+    int first; // of the list's matrices
+    int count;
+} RenderCommand;
+
+// everything a frame draws: its commands and the matrices the instances
+// take theirs from. the game thread records one while the render thread
+// draws the other
+typedef struct
+{
+    int frame;
+    RenderCommand *commands;
+    int commandCount;
+    int commandCapacity;
+    mat4_t *matrices;
+    int matrixCount;
+    int matrixCapacity;
+    // when the game thread started and finished recording it
+    Uint64 recordStart;
+    Uint64 recordEnd;
+} RenderList;
+
+// draws a list. runs on the render thread, with the context current
+typedef void (*RenderListFunc)(const RenderList *l, void *userdata);
+
+// two lists, recorded on the game thread and drawn on a thread of their
+// own that holds the gl context, so the game can simulate the next tick
+// while the driver takes this one. the game can get one list ahead and
+// waits for the render thread after that. without the thread a list is
+// drawn as soon as it is recorded
+typedef struct
+{
+    RenderList lists[2];
+    int recording; // game thread, like frames
+    int frames; // recorded
+    int drawing; // render thread
+    RenderListFunc draw;
+    void *userdata;
+
+    SDL_Window *window;
+    SDL_GLContext context;
+    SDL_sem *empty; // lists the game thread can record
+    SDL_sem *full; // lists waiting to be drawn
+    SDL_atomic_t quit;
+    SDL_Thread *thread; // NULL when lists are drawn on the game thread
+    int threaded;
+
+    // render thread only. when each frame was recorded and drawn, by frame
+    // number modulo RENDER_TIMELINE_FRAMES. a frame's recording is known
+    // once the render thread has picked it up
+    int recorded;
+    int drawn;
+    Uint64 simStart[RENDER_TIMELINE_FRAMES];
+    Uint64 simEnd[RENDER_TIMELINE_FRAMES];
+    Uint64 drawStart[RENDER_TIMELINE_FRAMES];
+    Uint64 drawEnd[RENDER_TIMELINE_FRAMES];
+    int idle; // frames the render thread had to wait for
+
+    SDL_atomic_t stalls; // frames the game thread waited for a list
+} Renderer;
+
+void initRenderList(RenderList *l);
+
+void freeRenderList(RenderList *l);
+
+// sets how many matrices the list has and returns them, growing it if
+// they don't fit
+mat4_t *listMatrices(RenderList *l, int count);
+
+// adds count instances of a mesh, with the matrices from first on
+void listMesh(RenderList *l, int mesh, int pass, float depth, int first, int count);
+
+void listStats(RenderList *l);
+
+// threaded hands the context over to a render thread that draws every
+// list with draw. the context has to be current on the calling thread, and
+// stays current there if the thread can't be started
+void startRenderer(Renderer *r, SDL_Window *window, SDL_GLContext context, int threaded, RenderListFunc draw, void *userdata);
+
+// stops the render thread, dropping any list it hadn't got to, and makes
+// the context current on the calling thread again
+void stopRenderer(Renderer *r);
+
+// game thread. returns the next list to record, empty, once the render
+// thread is done with it
+RenderList *beginFrame(Renderer *r);
+
+// game thread. hands the list over to be drawn
+void endFrame(Renderer *r);
+
+// render thread, or the game's once it is stopped. how long frames took to
+// record and draw, how much of the recording was hidden behind drawing,
+// and the last few frames on a timeline
+void printRenderer(Renderer *r);
+
+#endif
@@ -0,0 +1,213 @@
+#include <math.h>
+
+#include "resample.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static float sincTable[SINC_BANDS][SINC_PHASES][SINC_TAPS];
+
+// read past either end of a sample that doesn't loop
+static const float silence[8];
+
+void initResampler(Resampler *r, const float *data, unsigned long frames, int channels, int loop)
+{
+    r->data = data;
+    r->frames = frames;
+    r->channels = channels;
+    r->loop = loop;
+    // an empty source has nothing to read, not even its first frame
+    r->finished = frames == 0;
+    r->pos = 0;
+    r->frac = 0;
+}
+
+// looping samples read frames either side of them from the other end
+static const float *frameAt(const Resampler *r, long i)
+{
+    long frames = r->frames;
+    if (!r->loop && (i < 0 || i >= frames))
+        return silence;
+    while (i < 0)
+        i += frames;
+    while (i >= frames)
+        i -= frames;
+    return r->data + i * r->channels;
+}
+
+// step is 32.32 fixed point frames
+static void advance(Resampler *r, Uint64 step)
+{
+    if (r->frames == 0)
+    {
+        r->finished = 1;
+        return;
+    }
+    Uint32 frac = r->frac + (Uint32)step;
+    r->pos += (Uint32)(step >> 32) + (frac < r->frac);
+    r->frac = frac;
+    if (r->pos >= r->frames && !r->loop)
+        r->finished = 1;
+    while (r->pos >= r->frames)
+        r->pos -= r->frames;
+}
+
+static void resampleLinear(float *dst, int frames, Resampler *r, Uint64 step, Sint64 ramp)
+{
+    int channels = r->channels;
+    int i, c;
+    for (i = 0; i < frames && !r->finished; ++i)
+    {
+        const float *a = r->data + r->pos * channels;
+        const float *b = frameAt(r, r->pos + 1);
+        float t = r->frac * (1.0f / 4294967296.0f);
+        for (c = 0; c < channels; ++c)
+            *dst++ = a[c] + (b[c] - a[c]) * t;
+        advance(r, step);
+        step += ramp;
+    }
+    SDL_memset(dst, 0, (frames - i) * channels * sizeof(float));
+}
+
+static void resampleCubic(float *dst, int frames, Resampler *r, Uint64 step, Sint64 ramp)
+{
+    int channels = r->channels;
+    int i, c;
+    for (i = 0; i < frames && !r->finished; ++i)
+    {
+        const float *p0 = frameAt(r, (long)r->pos - 1);
+        const float *p1 = r->data + r->pos * channels;
+        const float *p2 = frameAt(r, r->pos + 1);
+        const float *p3 = frameAt(r, r->pos + 2);
+        float t = r->frac * (1.0f / 4294967296.0f);
+        for (c = 0; c < channels; ++c)
+        {
+            // catmull-rom hermite spline through p1 and p2
+            float c1 = 0.5f * (p2[c] - p0[c]);
+            float c2 = p0[c] - 2.5f * p1[c] + 2.0f * p2[c] - 0.5f * p3[c];
+            float c3 = 0.5f * (p3[c] - p0[c]) + 1.5f * (p1[c] - p2[c]);
+            *dst++ = ((c3 * t + c2) * t + c1) * t + p1[c];
+        }
+        advance(r, step);
+        step += ramp;
+    }
+    SDL_memset(dst, 0, (frames - i) * channels * sizeof(float));
+}
+
+static void resampleSinc(float *dst, int frames, Resampler *r, Uint64 step, Sint64 ramp, double rate)
+{
+    int channels = r->channels;
+    int band = (rate - 1.0) / (SINC_MAX_RATE - 1.0) * SINC_BANDS;
+    int i, c, k;
+    band = band < 0 ? 0 : band >= SINC_BANDS ? SINC_BANDS - 1 : band;
+
+    for (i = 0; i < frames && !r->finished; ++i)
+    {
+        const float *taps = sincTable[band][r->frac >> 24];
+        long first = (long)r->pos - SINC_TAPS / 2 + 1;
+        float sum[8] = { 0 };
+
+        if (first >= 0 && first + SINC_TAPS <= (long)r->frames)
+        {
+            const float *p = r->data + first * channels;
+            for (k = 0; k < SINC_TAPS; ++k, p += channels)
+                for (c = 0; c < channels; ++c)
+                    sum[c] += p[c] * taps[k];
+        }
+        else
+        {
+            for (k = 0; k < SINC_TAPS; ++k)
+            {
+                const float *p = frameAt(r, first + k);
+                for (c = 0; c < channels; ++c)
+                    sum[c] += p[c] * taps[k];
+            }
+        }
+
+        for (c = 0; c < channels; ++c)
+            *dst++ = sum[c];
+        advance(r, step);
+        step += ramp;
+    }
+    SDL_memset(dst, 0, (frames - i) * channels * sizeof(float));
+}
+
+void resample(float *dst, int frames, Resampler *r, double rate, double rateEnd, int quality)
+{
+    Uint64 step = (Uint64)(rate * 4294967296.0);
+    Sint64 ramp = frames > 0 ? (Sint64)((rateEnd - rate) * 4294967296.0) / frames : 0;
+
+    // the faster end of the ramp decides how much to filter
+    if (quality == RESAMPLE_SINC && r->channels <= 8)
+        resampleSinc(dst, frames, r, step, ramp, SDL_max(rate, rateEnd));
+    else if (quality == RESAMPLE_CUBIC)
+        resampleCubic(dst, frames, r, step, ramp);
+    else
+        resampleLinear(dst, frames, r, step, ramp);
+}
+
+void skipResampler(Resampler *r, int frames, double rate, double rateEnd)
+{
+    Uint64 step = (Uint64)(rate * 4294967296.0);
+    Sint64 ramp = frames > 0 ? (Sint64)((rateEnd - rate) * 4294967296.0) / frames : 0;
+    // the sum of the steps resample would have taken
+    Uint64 position = ((Uint64)r->pos << 32 | r->frac) + step * frames + ramp * ((Sint64)frames * (frames - 1) / 2);
+    Uint64 pos = position >> 32;
+
+    if (r->frames == 0)
+    {
+        r->finished = 1;
+        return;
+    }
+    if (pos >= r->frames)
+    {
+        if (!r->loop)
+            r->finished = 1;
+        pos %= r->frames;
+    }
+    r->pos = (Uint32)pos;
+    r->frac = (Uint32)position;
+}
+
+void initResample()
+{
+    int band, phase, k;
+    for (band = 0; band < SINC_BANDS; ++band)
+    {
+        // cut off below the nyquist frequency of the fastest rate in the band
+        double maxRate = 1.0 + (band + 1) * (SINC_MAX_RATE - 1.0) / SINC_BANDS;
+        double cutoff = 0.9 / maxRate;
+
+        for (phase = 0; phase < SINC_PHASES; ++phase)
+        {
+            double t = (double)phase / SINC_PHASES;
+            double total = 0;
+            for (k = 0; k < SINC_TAPS; ++k)
+            {
+                // distance from the tap to the point we're sampling
+                double x = k - (SINC_TAPS / 2 - 1) - t;
+                double sinc = x == 0 ? 1.0 : sin(M_PI * cutoff * x) / (M_PI * cutoff * x);
+                // blackman window over the whole filter
+                double w = (x + SINC_TAPS / 2) / SINC_TAPS;
+                double window = 0.42 - 0.5 * cos(2 * M_PI * w) + 0.08 * cos(4 * M_PI * w);
+                sincTable[band][phase][k] = sinc * window;
+                total += sinc * window;
+            }
+            // unity gain at dc
+            for (k = 0; k < SINC_TAPS; ++k)
+                sincTable[band][phase][k] /= total;
+        }
+    }
+}
+
+const char *resampleQualityName(int quality)
+{
+    switch (quality)
+    {
+        case RESAMPLE_LINEAR: return "linear";
+        case RESAMPLE_CUBIC: return "cubic";
+        case RESAMPLE_SINC: return "sinc";
+    }
+    return "unknown";
+}
@@ -0,0 +1,49 @@
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include <SDL.h>
+
+// quality tiers, cheapest first
+#define RESAMPLE_LINEAR 0
+#define RESAMPLE_CUBIC 1
+#define RESAMPLE_SINC 2
+#define RESAMPLE_QUALITY_COUNT 3
+
+// windowed sinc filter size. the phases are precomputed per rate band so
+// the filter cutoff follows the playback rate and pitching up doesn't alias
+#define SINC_TAPS 16
+#define SINC_PHASES 256
+#define SINC_BANDS 4
+#define SINC_MAX_RATE 2.0
+
+// playback position in a sample of interleaved float frames.
+// the position is 32.32 fixed point so it never drifts
+typedef struct
+{
+    const float *data;
+    unsigned long frames;
+    int channels;
+    int loop;
+    int finished; // set once a sample that doesn't loop has played out, or if it's empty
+    Uint32 pos;
+    Uint32 frac;
+} Resampler;
+
+void initResampler(Resampler *r, const float *data, unsigned long frames, int channels, int loop);
+
+// renders frames frames into dst, stepping through the source rate frames
+// per output frame (1 plays at the original pitch, 2 an octave up). the
+// rate moves smoothly to rateEnd over the block.
+// anything past the end of a sample that doesn't loop is silent
+void resample(float *dst, int frames, Resampler *r, double rate, double rateEnd, int quality);
+
+// moves the position on as far as resample would have without rendering
+// anything, so a voice nobody can hear stays in phase for when it can be
+void skipResampler(Resampler *r, int frames, double rate, double rateEnd);
+
+// builds the sinc tables
+void initResample();
+
+const char *resampleQualityName(int quality);
+
+#endif
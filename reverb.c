@@ -0,0 +1,371 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "reverb.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define REVERB_X86
+#include <immintrin.h>
+#endif
+
+ComplexMacFunc complexMac = complexMacScalar;
+
+void complexMacScalar(float *sumRe, float *sumIm, const float *aRe, const float *aIm, const float *bRe, const float *bIm, int count)
+{
+    int i;
+    for (i = 0; i < count; ++i)
+    {
+        sumRe[i] += aRe[i] * bRe[i] - aIm[i] * bIm[i];
+        sumIm[i] += aRe[i] * bIm[i] + aIm[i] * bRe[i];
+    }
+}
+
+#ifdef REVERB_X86
+
+__attribute__((target("sse2")))
+void complexMacSSE2(float *sumRe, float *sumIm, const float *aRe, const float *aIm, const float *bRe, const float *bIm, int count)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 ar = _mm_loadu_ps(aRe + i);
+        __m128 ai = _mm_loadu_ps(aIm + i);
+        __m128 br = _mm_loadu_ps(bRe + i);
+        __m128 bi = _mm_loadu_ps(bIm + i);
+        __m128 re = _mm_sub_ps(_mm_mul_ps(ar, br), _mm_mul_ps(ai, bi));
+        __m128 im = _mm_add_ps(_mm_mul_ps(ar, bi), _mm_mul_ps(ai, br));
+        _mm_storeu_ps(sumRe + i, _mm_add_ps(_mm_loadu_ps(sumRe + i), re));
+        _mm_storeu_ps(sumIm + i, _mm_add_ps(_mm_loadu_ps(sumIm + i), im));
+    }
+    complexMacScalar(sumRe + i, sumIm + i, aRe + i, aIm + i, bRe + i, bIm + i, count - i);
+}
+
+__attribute__((target("avx2")))
+void complexMacAVX2(float *sumRe, float *sumIm, const float *aRe, const float *aIm, const float *bRe, const float *bIm, int count)
+{
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 ar = _mm256_loadu_ps(aRe + i);
+        __m256 ai = _mm256_loadu_ps(aIm + i);
+        __m256 br = _mm256_loadu_ps(bRe + i);
+        __m256 bi = _mm256_loadu_ps(bIm + i);
+        __m256 re = _mm256_sub_ps(_mm256_mul_ps(ar, br), _mm256_mul_ps(ai, bi));
+        __m256 im = _mm256_add_ps(_mm256_mul_ps(ar, bi), _mm256_mul_ps(ai, br));
+        _mm256_storeu_ps(sumRe + i, _mm256_add_ps(_mm256_loadu_ps(sumRe + i), re));
+        _mm256_storeu_ps(sumIm + i, _mm256_add_ps(_mm256_loadu_ps(sumIm + i), im));
+    }
+    _mm256_zeroupper();
+    complexMacScalar(sumRe + i, sumIm + i, aRe + i, aIm + i, bRe + i, bIm + i, count - i);
+}
+
+#else
+
+void complexMacSSE2(float *sumRe, float *sumIm, const float *aRe, const float *aIm, const float *bRe, const float *bIm, int count)
+{
+    complexMacScalar(sumRe, sumIm, aRe, aIm, bRe, bIm, count);
+}
+
+void complexMacAVX2(float *sumRe, float *sumIm, const float *aRe, const float *aIm, const float *bRe, const float *bIm, int count)
+{
+    complexMacScalar(sumRe, sumIm, aRe, aIm, bRe, bIm, count);
+}
+
+#endif
+
+// in place radix 2 forward transform of r->size values
+static void fft(Reverb *r, float *re, float *im)
+{
+    int n = r->size;
+    int i, len;
+
+    for (i = 0; i < n; ++i)
+    {
+        int j = r->reverse[i];
+        if (i < j)
+        {
+            float t = re[i];
+            re[i] = re[j];
+            re[j] = t;
+            t = im[i];
+            im[i] = im[j];
+            im[j] = t;
+        }
+    }
+
+    for (len = 2; len <= n; len *= 2)
+    {
+        int half = len / 2;
+        int stride = n / len;
+        int start, k;
+        for (start = 0; start < n; start += len)
+            for (k = 0; k < half; ++k)
+            {
+                float wr = r->twiddleRe[k * stride];
+                float wi = r->twiddleIm[k * stride];
+                int a = start + k;
+                int b = a + half;
+                float tr = re[b] * wr - im[b] * wi;
+                float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+    }
+}
+
+// the inverse without the 1 / size, by conjugating on the way in and out
+static void inverseFft(Reverb *r, float *re, float *im)
+{
+    int i;
+    for (i = 0; i < r->size; ++i)
+        im[i] = -im[i];
+    fft(r, re, im);
+    for (i = 0; i < r->size; ++i)
+        im[i] = -im[i];
+}
+
+// returns 0 if there isn't the memory for them
+static int initTables(Reverb *r)
+{
+    int bits = 0;
+    int i, b;
+    while ((1 << bits) < r->size)
+        ++bits;
+
+    r->reverse = malloc(r->size * sizeof(int));
+    r->twiddleRe = malloc(r->size / 2 * sizeof(float));
+    r->twiddleIm = malloc(r->size / 2 * sizeof(float));
+    if (r->reverse == NULL || r->twiddleRe == NULL || r->twiddleIm == NULL)
+        return 0;
+
+    for (i = 0; i < r->size; ++i)
+    {
+        int j = 0;
+        for (b = 0; b < bits; ++b)
+            j |= (i >> b & 1) << (bits - 1 - b);
+        r->reverse[i] = j;
+    }
+
+    for (i = 0; i < r->size / 2; ++i)
+    {
+        r->twiddleRe[i] = (float)cos(2 * M_PI * i / r->size);
+        r->twiddleIm[i] = (float)-sin(2 * M_PI * i / r->size);
+    }
+    return 1;
+}
+
+// frees whatever of a reverb got allocated and gives up on it
+static Reverb *outOfMemory(Reverb *r)
+{
+    printf("Out of memory creating a reverb of %d partitions\n", r->partitions);
+    freeReverb(r);
+    return NULL;
+}
+
+Reverb *createReverb(const Sample *impulse, int blockFrames, float wet)
+{
+    Reverb *r;
+    int channels = impulse->channels;
+    double energy[2] = { 0, 0 };
+    float scale[2];
+    unsigned long i;
+    int p, c;
+
+    if (channels != 1 && channels != 2)
+    {
+        printf("Reverb impulses have to be mono or stereo\n");
+        return NULL;
+    }
+
+    r = calloc(1, sizeof(Reverb));
+    if (r == NULL)
+    {
+        printf("Out of memory creating a reverb\n");
+        return NULL;
+    }
+    r->blockFrames = 1;
+    while (r->blockFrames < blockFrames)
+        r->blockFrames *= 2;
+    r->size = r->blockFrames * 2;
+    r->partitions = SDL_max(1, (impulse->frames + r->blockFrames - 1) / r->blockFrames);
+    r->wet = wet;
+    if (!initTables(r))
+        return outOfMemory(r);
+
+    for (i = 0; i < impulse->frames; ++i)
+        for (c = 0; c < channels; ++c)
+            energy[c] += impulse->data[i * channels + c] * impulse->data[i * channels + c];
+    for (c = 0; c < channels; ++c)
+        scale[c] = energy[c] > 0 ? (float)(1 / sqrt(energy[c])) : 0;
+
+    // each partition is zero padded to the transform size, left in the
+    // real part and right in the imaginary part
+    r->impulseRe = calloc(r->partitions * r->size, sizeof(float));
+    r->impulseIm = calloc(r->partitions * r->size, sizeof(float));
+    if (r->impulseRe == NULL || r->impulseIm == NULL)
+        return outOfMemory(r);
+    for (p = 0; p < r->partitions; ++p)
+    {
+        float *re = r->impulseRe + p * r->size;
+        float *im = r->impulseIm + p * r->size;
+        int f;
+        for (f = 0; f < r->blockFrames && p * r->blockFrames + f < impulse->frames; ++f)
+        {
+            const float *frame = impulse->data + (p * r->blockFrames + f) * channels;
+            re[f] = frame[0] * scale[0];
+            im[f] = frame[channels - 1] * scale[channels - 1];
+        }
+        fft(r, re, im);
+    }
+
+    r->inputRe = calloc(r->partitions * r->size, sizeof(float));
+    r->inputIm = calloc(r->partitions * r->size, sizeof(float));
+    r->sumRe = malloc(r->size * sizeof(float));
+    r->sumIm = malloc(r->size * sizeof(float));
+    r->history = calloc(r->size, sizeof(float));
+    r->output = calloc(r->blockFrames * 2, sizeof(float));
+    if (r->inputRe == NULL || r->inputIm == NULL || r->sumRe == NULL || r->sumIm == NULL || r->history == NULL || r->output == NULL)
+        return outOfMemory(r);
+    return r;
+}
+
+void freeReverb(Reverb *r)
+{
+    free(r->reverse);
+    free(r->twiddleRe);
+    free(r->twiddleIm);
+    free(r->impulseRe);
+    free(r->impulseIm);
+    free(r->inputRe);
+    free(r->inputIm);
+    free(r->sumRe);
+    free(r->sumIm);
+    free(r->history);
+    free(r->output);
+    free(r);
+}
+
+void resetReverb(Reverb *r)
+{
+    SDL_memset(r->inputRe, 0, r->partitions * r->size * sizeof(float));
+    SDL_memset(r->inputIm, 0, r->partitions * r->size * sizeof(float));
+    SDL_memset(r->history, 0, r->size * sizeof(float));
+    SDL_memset(r->output, 0, r->blockFrames * 2 * sizeof(float));
+    r->fill = 0;
+}
+
+// runs once a whole block of input is in the second half of the history.
+// overlap save: the second half of the inverse is the clean output
+static void processBlock(Reverb *r)
+{
+    float scale = r->wet / r->size;
+    float *re, *im;
+    int p, i;
+
+    r->head = (r->head + 1) % r->partitions;
+    re = r->inputRe + r->head * r->size;
+    im = r->inputIm + r->head * r->size;
+    SDL_memcpy(re, r->history, r->size * sizeof(float));
+    SDL_memset(im, 0, r->size * sizeof(float));
+    fft(r, re, im);
+
+    SDL_memset(r->sumRe, 0, r->size * sizeof(float));
+    SDL_memset(r->sumIm, 0, r->size * sizeof(float));
+    for (p = 0; p < r->partitions; ++p)
+    {
+        int input = (r->head - p + r->partitions) % r->partitions;
+        complexMac(r->sumRe, r->sumIm, r->inputRe + input * r->size, r->inputIm + input * r->size,
+            r->impulseRe + p * r->size, r->impulseIm + p * r->size, r->size);
+    }
+    inverseFft(r, r->sumRe, r->sumIm);
+
+    for (i = 0; i < r->blockFrames; ++i)
+    {
+        r->output[i * 2] = r->sumRe[r->blockFrames + i] * scale;
+        r->output[i * 2 + 1] = r->sumIm[r->blockFrames + i] * scale;
+    }
+    SDL_memmove(r->history, r->history + r->blockFrames, r->blockFrames * sizeof(float));
+}
+
+void reverbProcess(Reverb *r, const float *send, float *bus, int frames, int channels)
+{
+    int done = 0;
+    while (done < frames)
+    {
+        int n = SDL_min(frames - done, r->blockFrames - r->fill);
+        float *in = r->history + r->blockFrames + r->fill;
+        const float *out = r->output + r->fill * 2;
+        int i;
+
+        if (channels == 2)
+            for (i = 0; i < n; ++i)
+            {
+                in[i] = (send[(done + i) * 2] + send[(done + i) * 2 + 1]) * 0.5f;
+                bus[(done + i) * 2] += out[i * 2];
+                bus[(done + i) * 2 + 1] += out[i * 2 + 1];
+            }
+        else
+            for (i = 0; i < n; ++i)
+            {
+                in[i] = send[done + i];
+                bus[done + i] += (out[i * 2] + out[i * 2 + 1]) * 0.5f;
+            }
+
+        done += n;
+        r->fill += n;
+        if (r->fill == r->blockFrames)
+        {
+            processBlock(r);
+            r->fill = 0;
+        }
+    }
+}
+
+int makeImpulse(Sample *s, int freq, float seconds, float decay, Uint32 seed)
+{
+    unsigned long i;
+    s->channels = 2;
+    s->frames = (unsigned long)(seconds * freq);
+    s->data = malloc(s->frames * 2 * sizeof(float));
+    if (s->data == NULL && s->frames > 0)
+    {
+        printf("Out of memory making a %.2f second impulse\n", seconds);
+        s->frames = 0;
+        return 0;
+    }
+    for (i = 0; i < s->frames * 2; ++i)
+    {
+        // 60 db is a factor of 1000, e^-6.91
+        float envelope = (float)exp(-6.91 * (i / 2) / (decay * freq));
+        seed = seed * 1664525 + 1013904223;
+        s->data[i] = ((seed >> 8) * (2.0f / 16777216.0f) - 1.0f) * envelope;
+    }
+    return 1;
+}
+
+void initReverb()
+{
+    complexMac = complexMacScalar;
+#ifdef REVERB_X86
+    if (SDL_HasAVX2())
+        complexMac = complexMacAVX2;
+    else if (SDL_HasSSE2())
+        complexMac = complexMacSSE2;
+#endif
+}
+
+const char *reverbKernelName()
+{
+    if (complexMac == complexMacAVX2)
+        return "avx2";
+    if (complexMac == complexMacSSE2)
+        return "sse2";
+    return "scalar";
+}
@@ -0,0 +1,80 @@
+#ifndef REVERB_H
+#define REVERB_H
+
+#include <SDL.h>
+
+#include "sample.h"
+
+// a convolution reverb for the send bus. the impulse response is cut into
+// partitions of blockFrames frames, each transformed once when the reverb
+// is made. every blockFrames frames of input are transformed and multiplied
+// with each partition's spectrum against the spectrum of the input that
+// many blocks ago, so the cost per frame grows with the impulse length over
+// the block size and not with the impulse length alone.
+// the left and right impulses are packed as the real and imaginary parts of
+// one complex signal, so one multiply and one inverse transform give both
+// output channels. the wet signal comes out blockFrames frames late
+typedef struct
+{
+    int blockFrames; // power of two
+    int size; // transform size, two blocks
+    int partitions;
+    float wet;
+
+    // the fft tables for size
+    int *reverse;
+    float *twiddleRe;
+    float *twiddleIm;
+
+    // partitions spectra of the impulse, one after the other
+    float *impulseRe;
+    float *impulseIm;
+
+    // the spectra of the last partitions input blocks, newest at head
+    float *inputRe;
+    float *inputIm;
+    int head;
+
+    float *sumRe;
+    float *sumIm;
+    float *history; // the last two blocks of mono input
+    float *output; // the wet stereo frames of the last block
+    int fill; // frames into the current block
+} Reverb;
+
+// makes a reverb from a mono or stereo impulse response, normalised so each
+// channel has the energy of a single click. wet scales the output.
+// returns NULL if the impulse has more than two channels or there isn't the
+// memory for it
+Reverb *createReverb(const Sample *impulse, int blockFrames, float wet);
+
+void freeReverb(Reverb *r);
+
+// clears the tail so the reverb starts from silence
+void resetReverb(Reverb *r);
+
+// takes frames frames of the send bus and adds the wet signal into bus.
+// both are interleaved with channels channels, 1 or 2
+void reverbProcess(Reverb *r, const float *send, float *bus, int frames, int channels);
+
+// a synthetic room, stereo noise decaying by 60 db over decay seconds.
+// returns 0, leaving s empty, if there isn't the memory for it
+int makeImpulse(Sample *s, int freq, float seconds, float decay, Uint32 seed);
+
+// picks the multiply kernel for this cpu
+void initReverb();
+
+const char *reverbKernelName();
+
+// multiply accumulate of count complex values held as separate real and
+// imaginary arrays, sum += a * b
+typedef void (*ComplexMacFunc)(float *sumRe, float *sumIm, const float *aRe, const float *aIm, const float *bRe, const float *bIm, int count);
+
+void complexMacScalar(float *sumRe, float *sumIm, const float *aRe, const float *aIm, const float *bRe, const float *bIm, int count);
+void complexMacSSE2(float *sumRe, float *sumIm, const float *aRe, const float *aIm, const float *bRe, const float *bIm, int count);
+void complexMacAVX2(float *sumRe, float *sumIm, const float *aRe, const float *aIm, const float *bRe, const float *bIm, int count);
+
+// best kernel for this cpu, set by initReverb()
+extern ComplexMacFunc complexMac;
+
+#endif
@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sample.h"
+
+int loadSample(Sample *s, const char *path, int freq)
+{
+    SDL_AudioSpec spec;
+    SDL_AudioCVT cvt;
+    Uint8 *buffer;
+    Uint32 length;
+
+    if (SDL_LoadWAV(path, &spec, &buffer, &length) == NULL)
+    {
+        printf("Could not open %s: %s\n", path, SDL_GetError());
+        return 0;
+    }
+
+    if (SDL_BuildAudioCVT(&cvt, spec.format, spec.channels, spec.freq, AUDIO_F32SYS, spec.channels, freq) < 0)
+    {
+        printf("Could not convert %s: %s\n", path, SDL_GetError());
+        SDL_FreeWAV(buffer);
+        return 0;
+    }
+
+    // SDL converts in place so the buffer has to fit the larger of the two
+    cvt.len = length;
+    cvt.buf = malloc(length * cvt.len_mult);
+    if (cvt.buf == NULL)
+    {
+        printf("Out of memory loading %s\n", path);
+        SDL_FreeWAV(buffer);
+        return 0;
+    }
+    SDL_memcpy(cvt.buf, buffer, length);
+    SDL_FreeWAV(buffer);
+
+    if (SDL_ConvertAudio(&cvt) < 0)
+    {
+        printf("Could not convert %s: %s\n", path, SDL_GetError());
+        free(cvt.buf);
+        return 0;
+    }
+
+    s->channels = spec.channels;
+    s->frames = cvt.len_cvt / (sizeof(float) * spec.channels);
+    // the mixer has nothing to play in an empty sample
+    if (s->frames == 0)
+    {
+        printf("%s has no frames\n", path);
+        free(cvt.buf);
+        return 0;
+    }
+    // only ever shrinks, so if it fails the larger buffer still holds it
+    s->data = realloc(cvt.buf, cvt.len_cvt);
+    if (s->data == NULL)
+        s->data = (float *)cvt.buf;
+    return 1;
+}
+
+void freeSample(Sample *s)
+{
+    free(s->data);
+    s->data = NULL;
+    s->frames = 0;
+}
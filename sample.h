@@ -0,0 +1,21 @@
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+#include <SDL.h>
+
+// a whole sound in memory as interleaved float frames, already converted
+// to the mixer's rate so voices only ever resample for pitch
+typedef struct
+{
+    float *data;
+    unsigned long frames;
+    int channels;
+} Sample;
+
+// loads a wav file and converts it to float at freq, keeping its channels.
+// returns 0 if the file can't be loaded or converted, or has no frames
+int loadSample(Sample *s, const char *path, int freq);
+
+void freeSample(Sample *s);
+
+#endif
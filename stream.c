@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "stream.h"
+
+// how much the reader reads at a time, as a fraction of the window
+#define STREAM_CHUNKS 4
+
+// finds the fmt and data chunks of a 16 bit pcm wav
+static int readWavHeader(SampleStream *s)
+{
+    Uint32 riff = SDL_ReadLE32(s->file);
+    Uint32 size;
+    SDL_ReadLE32(s->file);
+    if (riff != 0x46464952 || SDL_ReadLE32(s->file) != 0x45564157) // "RIFF" "WAVE"
+        return 0;
+
+    s->channels = 0;
+    for (;;)
+    {
+        Uint32 id = SDL_ReadLE32(s->file);
+        Sint64 next;
+        size = SDL_ReadLE32(s->file);
+        if (size == 0 && id == 0)
+            return 0;
+        next = SDL_RWtell(s->file) + size + (size & 1);
+
+        if (id == 0x20746d66) // "fmt "
+        {
+            Uint16 format = SDL_ReadLE16(s->file);
+            s->channels = SDL_ReadLE16(s->file);
+            s->freq = SDL_ReadLE32(s->file);
+            SDL_ReadLE32(s->file); // byte rate
+            SDL_ReadLE16(s->file); // block align
+            if (format != 1 || SDL_ReadLE16(s->file) != 16)
+                return 0;
+        }
+        else if (id == 0x61746164) // "data"
+        {
+            if (s->channels == 0)
+                return 0;
+            s->dataStart = SDL_RWtell(s->file);
+            s->dataFrames = size / (s->channels * sizeof(Sint16));
+            return 1;
+        }
+
+        if (SDL_RWseek(s->file, next, RW_SEEK_SET) < 0)
+            return 0;
+    }
+}
+
+// fills up to frames frames of the ring from the file, starting at ring
+// frame first. returns how many it read
+static int readChunk(SampleStream *s, int first, int frames)
+{
+    int done = 0;
+    int i;
+    while (done < frames)
+    {
+        int n = SDL_min(frames - done, s->dataFrames - s->fileFrame);
+        int ringFrame = (first + done) & (s->ringFrames - 1);
+        n = SDL_min(n, s->ringFrames - ringFrame);
+
+        if (n == 0)
+        {
+            if (!s->loop)
+                break;
+            s->fileFrame = 0;
+            SDL_RWseek(s->file, s->dataStart, RW_SEEK_SET);
+            continue;
+        }
+
+        n = SDL_min(n, s->ringFrames / STREAM_CHUNKS);
+        n = SDL_RWread(s->file, s->chunk, s->channels * sizeof(Sint16), n);
+        if (n <= 0)
+            break;
+        for (i = 0; i < n * s->channels; ++i)
+            s->ring[ringFrame * s->channels + i] = s->chunk[i] * (1.0f / 32768.0f);
+        s->fileFrame += n;
+        done += n;
+    }
+    return done;
+}
+
+static int readerThread(void *data)
+{
+    SampleStream *s = data;
+    int chunk = s->ringFrames / STREAM_CHUNKS;
+    // sleep for about half of a chunk when the ring is full
+    int delay = SDL_max(1, chunk * 500 / s->freq);
+
+    while (!SDL_AtomicGet(&s->quit))
+    {
+        int written = SDL_AtomicGet(&s->written);
+        int room = s->ringFrames - (written - SDL_AtomicGet(&s->released));
+        int n;
+
+        if (room < chunk)
+        {
+            SDL_Delay(delay);
+            continue;
+        }
+
+        n = readChunk(s, written, chunk);
+        // the frames have to land before the count that covers them
+        SDL_MemoryBarrierRelease();
+        SDL_AtomicSet(&s->written, written + n);
+
+        if (n < chunk)
+        {
+            SDL_AtomicSet(&s->eof, 1);
+            break;
+        }
+    }
+    return 0;
+}
+
+SampleStream *openStream(const char *path, int windowFrames, int loop)
+{
+    SampleStream *s = calloc(1, sizeof(SampleStream));
+    if (s == NULL)
+    {
+        printf("Out of memory loading %s\n", path);
+        return NULL;
+    }
+    s->loop = loop;
+    s->file = SDL_RWFromFile(path, "rb");
+    if (s->file == NULL)
+    {
+        printf("Could not open %s: %s\n", path, SDL_GetError());
+        free(s);
+        return NULL;
+    }
+    if (!readWavHeader(s))
+    {
+        printf("%s is not a 16 bit pcm wav\n", path);
+        SDL_RWclose(s->file);
+        free(s);
+        return NULL;
+    }
+    // looping would rewind forever without reading anything
+    if (s->dataFrames == 0)
+    {
+        printf("%s has no frames\n", path);
+        SDL_RWclose(s->file);
+        free(s);
+        return NULL;
+    }
+
+    s->ringFrames = STREAM_CHUNKS;
+    while (s->ringFrames < windowFrames)
+        s->ringFrames *= 2;
+    s->ring = calloc(s->ringFrames * s->channels, sizeof(float));
+    s->chunk = malloc(s->ringFrames / STREAM_CHUNKS * s->channels * sizeof(Sint16));
+    if (s->ring == NULL || s->chunk == NULL)
+    {
+        printf("Out of memory loading %s\n", path);
+        SDL_RWclose(s->file);
+        free(s->ring);
+        free(s->chunk);
+        free(s);
+        return NULL;
+    }
+
+    // prime the ring so playback can start straight away
+    SDL_AtomicSet(&s->written, readChunk(s, 0, s->ringFrames / 2));
+    s->thread = SDL_CreateThread(readerThread, "stream reader", s);
+    if (s->thread == NULL)
+    {
+        printf("Could not start reading %s: %s\n", path, SDL_GetError());
+        SDL_RWclose(s->file);
+        free(s->ring);
+        free(s->chunk);
+        free(s);
+        return NULL;
+    }
+    return s;
+}
+
+void closeStream(SampleStream *s)
+{
+    SDL_AtomicSet(&s->quit, 1);
+    SDL_WaitThread(s->thread, NULL);
+    SDL_RWclose(s->file);
+    free(s->ring);
+    free(s->chunk);
+    free(s);
+}
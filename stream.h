@@ -0,0 +1,46 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <SDL.h>
+
+// default amount of a streamed file kept in memory, about 0.7 s at 48khz
+#define STREAM_WINDOW_FRAMES 32768
+
+// a 16 bit wav file read from disk in chunks by a background thread,
+// converted to float and written into a ring buffer, so memory use is
+// bounded by the window and not the file.
+// the audio thread plays the ring through a looping Resampler and tells
+// the reader how far it has got
+typedef struct
+{
+    SDL_RWops *file;
+    Sint64 dataStart; // offset of the pcm data in the file
+    Uint32 dataFrames;
+    Uint32 fileFrame; // next frame the reader will read
+    int freq;
+    int channels;
+    int loop;
+
+    float *ring;
+    int ringFrames; // power of two
+    Sint16 *chunk; // the reader's file buffer
+
+    // frame counts since the start, they only ever go up
+    SDL_atomic_t written; // by the reader thread
+    SDL_atomic_t released; // by the audio thread, anything before this can be overwritten
+    SDL_atomic_t eof; // the reader has written the last frame of a file that doesn't loop
+    SDL_atomic_t underruns; // buffers the audio thread found the ring too empty for
+
+    SDL_atomic_t quit;
+    SDL_Thread *thread;
+} SampleStream;
+
+// opens a wav file and starts reading it. windowFrames is rounded up to a
+// power of two. returns NULL if the file can't be read or has no frames
+SampleStream *openStream(const char *path, int windowFrames, int loop);
+
+// stops the reader thread and frees the stream. nothing may still be
+// playing it, so stop its voice and close the audio device first
+void closeStream(SampleStream *s);
+
+#endif
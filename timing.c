@@ -0,0 +1,79 @@
+#include <stdio.h>
+
+#include "timing.h"
+
+// SDL doesn't tell us when the device runs dry. it asks for the next
+// buffer about once a budget, so a gap this much longer means the device
+// played out everything it had before we got back to it
+#define TIMING_UNDERRUN_PERCENT 150
+
+void initAudioTiming(AudioTiming *t, int freq, int frames)
+{
+    SDL_memset(t, 0, sizeof(AudioTiming));
+    t->budget = SDL_GetPerformanceFrequency() * frames / freq;
+}
+
+Uint64 beginAudioTiming(AudioTiming *t)
+{
+    Uint64 start = SDL_GetPerformanceCounter();
+    if (t->lastStart != 0 && (start - t->lastStart) * 100 > t->budget * TIMING_UNDERRUN_PERCENT)
+        SDL_AtomicAdd(&t->underruns, 1);
+    t->lastStart = start;
+    return start;
+}
+
+void endAudioTiming(AudioTiming *t, Uint64 start)
+{
+    Uint64 elapsed = SDL_GetPerformanceCounter() - start;
+    int percent = (int)(elapsed * 100 / t->budget);
+    int micros = (int)(elapsed * 1000000 / SDL_GetPerformanceFrequency());
+
+    SDL_AtomicAdd(&t->buckets[SDL_min(percent / TIMING_BUCKET_PERCENT, TIMING_BUCKETS - 1)], 1);
+    SDL_AtomicAdd(&t->callbacks, 1);
+    if (elapsed > t->budget)
+        SDL_AtomicAdd(&t->misses, 1);
+    // nobody else writes it, so this doesn't need a compare and swap
+    if (micros > SDL_AtomicGet(&t->maxMicros))
+        SDL_AtomicSet(&t->maxMicros, micros);
+}
+
+// the upper edge of the bucket the fraction of callbacks falls in, in
+// percent of the budget
+static int percentile(AudioTiming *t, int callbacks, float fraction)
+{
+    int count = 0;
+    int i;
+    for (i = 0; i < TIMING_BUCKETS - 1; ++i)
+    {
+        count += SDL_AtomicGet(&t->buckets[i]);
+        if (count >= callbacks * fraction)
+            break;
+    }
+    return (i + 1) * TIMING_BUCKET_PERCENT;
+}
+
+void printAudioTiming(AudioTiming *t)
+{
+    int callbacks = SDL_AtomicGet(&t->callbacks);
+    double budgetMicros = t->budget * 1000000.0 / SDL_GetPerformanceFrequency();
+    int i;
+
+    printf("audio callbacks: %d, budget %.0f us, max %d us, misses %d, underruns %d\n",
+        callbacks, budgetMicros, SDL_AtomicGet(&t->maxMicros),
+        SDL_AtomicGet(&t->misses), SDL_AtomicGet(&t->underruns));
+    if (callbacks == 0)
+        return;
+
+    printf("p50 <= %d%%, p99 <= %d%% of budget\n",
+        percentile(t, callbacks, 0.5f), percentile(t, callbacks, 0.99f));
+    for (i = 0; i < TIMING_BUCKETS; ++i)
+    {
+        int count = SDL_AtomicGet(&t->buckets[i]);
+        if (count == 0)
+            continue;
+        if (i == TIMING_BUCKETS - 1)
+            printf("  >=%3d%% %d\n", i * TIMING_BUCKET_PERCENT, count);
+        else
+            printf("  <%4d%% %d\n", (i + 1) * TIMING_BUCKET_PERCENT, count);
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <SDL.h>
+
+// histogram buckets are this many percent of the budget wide, and the
+// last one takes everything over TIMING_BUCKETS * TIMING_BUCKET_PERCENT
+#define TIMING_BUCKET_PERCENT 5
+#define TIMING_BUCKETS 41
+
+// how long each audio callback takes against the time it has, which is
+// how long the buffer it fills takes to play.
+// the audio thread is the only writer and only does atomic adds and sets,
+// so any thread can print the stats while it runs
+typedef struct
+{
+    Uint64 budget; // performance counter ticks per buffer
+    Uint64 lastStart; // audio thread only
+
+    SDL_atomic_t buckets[TIMING_BUCKETS];
+    SDL_atomic_t callbacks;
+    SDL_atomic_t misses; // callbacks that took longer than the budget
+    SDL_atomic_t underruns; // gaps between callbacks long enough for the device to run dry
+    SDL_atomic_t maxMicros;
+} AudioTiming;
+
+// the budget of a buffer of frames frames at freq
+void initAudioTiming(AudioTiming *t, int freq, int frames);
+
+// audio thread, around the work of each callback.
+// beginAudioTiming returns the start time to pass to endAudioTiming
+Uint64 beginAudioTiming(AudioTiming *t);
+void endAudioTiming(AudioTiming *t, Uint64 start);
+
+// prints the counters and the histogram
+void printAudioTiming(AudioTiming *t);
+
+#endif